@@ -0,0 +1,357 @@
+#include <algorithm>
+#include "area_scaler.h"
+#include "pixel_kernels.h"
+
+#if defined(IMAGEVIEWER_SIMD_X86)
+#include <immintrin.h>
+#elif defined(IMAGEVIEWER_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+constexpr int kWeightBits = 14;
+constexpr quint32 kWeightOne = 1U << kWeightBits;
+constexpr int kNormalizeShift = kWeightBits - 8;
+constexpr quint32 kNormalizeRound = 1U << (kNormalizeShift - 1);
+constexpr int kOutputShift = kWeightBits + 8;
+constexpr quint32 kOutputRound = 1U << (kOutputShift - 1);
+constexpr int kChannels = 4;
+
+void accumulate_scalar(const uchar* row, quint32 weight, quint32* acc, int values)
+{
+    for (int i = 0; i < values; ++i)
+    {
+        acc[i] += row[i] * weight;
+    }
+}
+
+void finish_pixel(const quint32* sums, uchar* out)
+{
+    for (int c = 0; c < kChannels; ++c)
+    {
+        out[c] = static_cast<uchar>((sums[c] + kOutputRound) >> kOutputShift);
+    }
+}
+
+template<typename Taps>
+void horizontal_scalar(const quint16* row, const Taps& taps, uchar* out)
+{
+    const int width = static_cast<int>(taps.first.size());
+    for (int x = 0; x < width; ++x)
+    {
+        quint32 sums[kChannels] = {};
+        const quint16* source = row + (static_cast<qsizetype>(taps.first[x]) * kChannels);
+        const quint32* weights = taps.weights.data() + taps.offset[x];
+        for (int k = 0; k < taps.count[x]; ++k)
+        {
+            for (int c = 0; c < kChannels; ++c)
+            {
+                sums[c] += source[(k * kChannels) + c] * weights[k];
+            }
+        }
+        finish_pixel(sums, out + (static_cast<qsizetype>(x) * kChannels));
+    }
+}
+
+#ifdef IMAGEVIEWER_SIMD_X86
+__m128i widen_multiply_lo(__m128i values, __m128i weights)
+{
+    return _mm_unpacklo_epi16(_mm_mullo_epi16(values, weights), _mm_mulhi_epu16(values, weights));
+}
+
+__m128i widen_multiply_hi(__m128i values, __m128i weights)
+{
+    return _mm_unpackhi_epi16(_mm_mullo_epi16(values, weights), _mm_mulhi_epu16(values, weights));
+}
+
+void store_pixel_sse(__m128i sums, uchar* out)
+{
+    alignas(16) quint32 lanes[kChannels];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+    finish_pixel(lanes, out);
+}
+
+void accumulate_sse41(const uchar* row, quint32 weight, quint32* acc, int values)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_set1_epi16(static_cast<short>(weight));
+    int i = 0;
+    for (; i + 16 <= values; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128i* dst = reinterpret_cast<__m128i*>(acc + i);
+        _mm_storeu_si128(dst + 0, _mm_add_epi32(_mm_loadu_si128(dst + 0), widen_multiply_lo(lo, weights)));
+        _mm_storeu_si128(dst + 1, _mm_add_epi32(_mm_loadu_si128(dst + 1), widen_multiply_hi(lo, weights)));
+        _mm_storeu_si128(dst + 2, _mm_add_epi32(_mm_loadu_si128(dst + 2), widen_multiply_lo(hi, weights)));
+        _mm_storeu_si128(dst + 3, _mm_add_epi32(_mm_loadu_si128(dst + 3), widen_multiply_hi(hi, weights)));
+    }
+    accumulate_scalar(row + i, weight, acc + i, values - i);
+}
+
+template<typename Taps>
+void horizontal_sse41(const quint16* row, const Taps& taps, uchar* out)
+{
+    const int width = static_cast<int>(taps.first.size());
+    for (int x = 0; x < width; ++x)
+    {
+        const quint16* source = row + (static_cast<qsizetype>(taps.first[x]) * kChannels);
+        const quint32* weights = taps.weights.data() + taps.offset[x];
+        const int count = taps.count[x];
+        __m128i sums = _mm_setzero_si128();
+        int k = 0;
+        for (; k + 2 <= count; k += 2)
+        {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + (k * kChannels)));
+            const short w0 = static_cast<short>(weights[k]);
+            const short w1 = static_cast<short>(weights[k + 1]);
+            const __m128i pair_weights = _mm_set_epi16(w1, w1, w1, w1, w0, w0, w0, w0);
+            sums = _mm_add_epi32(sums, _mm_add_epi32(widen_multiply_lo(pixels, pair_weights), widen_multiply_hi(pixels, pair_weights)));
+        }
+        if (k < count)
+        {
+            const __m128i pixel = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + (k * kChannels)));
+            sums = _mm_add_epi32(sums, widen_multiply_lo(pixel, _mm_set1_epi16(static_cast<short>(weights[k]))));
+        }
+        store_pixel_sse(sums, out + (static_cast<qsizetype>(x) * kChannels));
+    }
+}
+
+__attribute__((target("avx2"))) void accumulate_avx2(const uchar* row, quint32 weight, quint32* acc, int values)
+{
+    const __m256i weights = _mm256_set1_epi16(static_cast<short>(weight));
+    int i = 0;
+    for (; i + 16 <= values; i += 16)
+    {
+        const __m256i words = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)));
+        const __m256i low = _mm256_mullo_epi16(words, weights);
+        const __m256i high = _mm256_mulhi_epu16(words, weights);
+        const __m256i products_lo = _mm256_unpacklo_epi16(low, high);
+        const __m256i products_hi = _mm256_unpackhi_epi16(low, high);
+        __m256i* dst = reinterpret_cast<__m256i*>(acc + i);
+        _mm256_storeu_si256(dst + 0, _mm256_add_epi32(_mm256_loadu_si256(dst + 0), _mm256_permute2x128_si256(products_lo, products_hi, 0x20)));
+        _mm256_storeu_si256(dst + 1, _mm256_add_epi32(_mm256_loadu_si256(dst + 1), _mm256_permute2x128_si256(products_lo, products_hi, 0x31)));
+    }
+    accumulate_scalar(row + i, weight, acc + i, values - i);
+}
+
+template<typename Taps>
+__attribute__((target("avx2"))) void horizontal_avx2(const quint16* row, const Taps& taps, uchar* out)
+{
+    const int width = static_cast<int>(taps.first.size());
+    for (int x = 0; x < width; ++x)
+    {
+        const quint16* source = row + (static_cast<qsizetype>(taps.first[x]) * kChannels);
+        const quint32* weights = taps.weights.data() + taps.offset[x];
+        const int count = taps.count[x];
+        __m256i wide_sums = _mm256_setzero_si256();
+        int k = 0;
+        for (; k + 4 <= count; k += 4)
+        {
+            const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + (k * kChannels)));
+            const short w0 = static_cast<short>(weights[k]);
+            const short w1 = static_cast<short>(weights[k + 1]);
+            const short w2 = static_cast<short>(weights[k + 2]);
+            const short w3 = static_cast<short>(weights[k + 3]);
+            const __m256i quad_weights = _mm256_set_epi16(w3, w3, w3, w3, w2, w2, w2, w2, w1, w1, w1, w1, w0, w0, w0, w0);
+            const __m256i low = _mm256_mullo_epi16(pixels, quad_weights);
+            const __m256i high = _mm256_mulhi_epu16(pixels, quad_weights);
+            wide_sums = _mm256_add_epi32(wide_sums, _mm256_add_epi32(_mm256_unpacklo_epi16(low, high), _mm256_unpackhi_epi16(low, high)));
+        }
+        __m128i sums = _mm_add_epi32(_mm256_castsi256_si128(wide_sums), _mm256_extracti128_si256(wide_sums, 1));
+        for (; k < count; ++k)
+        {
+            const __m128i pixel = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + (k * kChannels)));
+            sums = _mm_add_epi32(sums, widen_multiply_lo(pixel, _mm_set1_epi16(static_cast<short>(weights[k]))));
+        }
+        store_pixel_sse(sums, out + (static_cast<qsizetype>(x) * kChannels));
+    }
+}
+#endif
+
+#ifdef IMAGEVIEWER_SIMD_NEON
+void accumulate_neon(const uchar* row, quint32 weight, quint32* acc, int values)
+{
+    const auto w = static_cast<uint16_t>(weight);
+    int i = 0;
+    for (; i + 16 <= values; i += 16)
+    {
+        const uint8x16_t bytes = vld1q_u8(row + i);
+        const uint16x8_t lo = vmovl_u8(vget_low_u8(bytes));
+        const uint16x8_t hi = vmovl_u8(vget_high_u8(bytes));
+        vst1q_u32(acc + i + 0, vmlal_n_u16(vld1q_u32(acc + i + 0), vget_low_u16(lo), w));
+        vst1q_u32(acc + i + 4, vmlal_n_u16(vld1q_u32(acc + i + 4), vget_high_u16(lo), w));
+        vst1q_u32(acc + i + 8, vmlal_n_u16(vld1q_u32(acc + i + 8), vget_low_u16(hi), w));
+        vst1q_u32(acc + i + 12, vmlal_n_u16(vld1q_u32(acc + i + 12), vget_high_u16(hi), w));
+    }
+    accumulate_scalar(row + i, weight, acc + i, values - i);
+}
+
+template<typename Taps>
+void horizontal_neon(const quint16* row, const Taps& taps, uchar* out)
+{
+    const int width = static_cast<int>(taps.first.size());
+    for (int x = 0; x < width; ++x)
+    {
+        const quint16* source = row + (static_cast<qsizetype>(taps.first[x]) * kChannels);
+        const quint32* weights = taps.weights.data() + taps.offset[x];
+        uint32x4_t sums = vdupq_n_u32(0);
+        for (int k = 0; k < taps.count[x]; ++k)
+        {
+            sums = vmlal_n_u16(sums, vld1_u16(source + (k * kChannels)), static_cast<uint16_t>(weights[k]));
+        }
+        quint32 lanes[kChannels];
+        vst1q_u32(lanes, sums);
+        finish_pixel(lanes, out + (static_cast<qsizetype>(x) * kChannels));
+    }
+}
+#endif
+}
+
+area_scaler::area_scaler(const QSize& source_size, const QSize& target_size, QImage::Format format, cpu_features::simd_level level)
+    : source_size_(source_size), target_size_(target_size), kernels_(kernels_for(level))
+{
+    if (source_size.isEmpty() || target_size.isEmpty() || target_size.width() > source_size.width() ||
+        target_size.height() > source_size.height() || QImage::toPixelFormat(format).bitsPerPixel() != 32)
+    {
+        return;
+    }
+
+    horizontal_taps_ = build_taps(source_size.width(), target_size.width());
+    vertical_taps_ = build_taps(source_size.height(), target_size.height());
+    accumulator_.assign(static_cast<size_t>(source_size.width()) * kChannels, 0);
+    normalized_.resize(accumulator_.size());
+    image_ = QImage(target_size, format);
+}
+
+area_scaler::tap_table area_scaler::build_taps(int source_length, int target_length)
+{
+    tap_table taps;
+    taps.first.reserve(static_cast<size_t>(target_length));
+    taps.count.reserve(static_cast<size_t>(target_length));
+    taps.offset.reserve(static_cast<size_t>(target_length));
+
+    const qint64 source_unit = target_length;
+    const qint64 target_unit = source_length;
+    for (int o = 0; o < target_length; ++o)
+    {
+        const qint64 begin = o * target_unit;
+        const qint64 end = begin + target_unit;
+        const int first = static_cast<int>(begin / source_unit);
+        const int last = static_cast<int>((end - 1) / source_unit);
+
+        taps.first.push_back(first);
+        taps.count.push_back(last - first + 1);
+        taps.offset.push_back(static_cast<int>(taps.weights.size()));
+
+        qint64 covered = 0;
+        quint32 assigned = 0;
+        for (int i = first; i <= last; ++i)
+        {
+            covered += std::min((i + 1) * source_unit, end) - std::max(i * source_unit, begin);
+            const auto cumulative = static_cast<quint32>(((covered * kWeightOne) + (target_unit / 2)) / target_unit);
+            taps.weights.push_back(cumulative - assigned);
+            assigned = cumulative;
+        }
+    }
+    return taps;
+}
+
+area_scaler::kernel_set area_scaler::kernels_for(cpu_features::simd_level level)
+{
+    switch (cpu_features::supports(level) ? level : cpu_features::simd_level::scalar)
+    {
+#ifdef IMAGEVIEWER_SIMD_X86
+        case cpu_features::simd_level::sse41:
+            return {accumulate_sse41, horizontal_sse41<tap_table>};
+        case cpu_features::simd_level::avx2:
+            return {accumulate_avx2, horizontal_avx2<tap_table>};
+#endif
+#ifdef IMAGEVIEWER_SIMD_NEON
+        case cpu_features::simd_level::neon:
+            return {accumulate_neon, horizontal_neon<tap_table>};
+#endif
+        default:
+            return {accumulate_scalar, horizontal_scalar<tap_table>};
+    }
+}
+
+void area_scaler::push_row(const uchar* row)
+{
+    if (!is_valid() || source_row_ >= source_size_.height())
+    {
+        return;
+    }
+
+    const int values = static_cast<int>(accumulator_.size());
+    const int row_index = source_row_++;
+    while (target_row_ < target_size_.height())
+    {
+        const int first = vertical_taps_.first[target_row_];
+        if (row_index < first)
+        {
+            break;
+        }
+
+        const int tap = row_index - first;
+        kernels_.accumulate(row, vertical_taps_.weights[vertical_taps_.offset[target_row_] + tap], accumulator_.data(), values);
+        if (tap + 1 < vertical_taps_.count[target_row_])
+        {
+            break;
+        }
+        finish_output_row();
+    }
+}
+
+void area_scaler::finish_output_row()
+{
+    for (size_t i = 0; i < accumulator_.size(); ++i)
+    {
+        normalized_[i] = static_cast<quint16>((accumulator_[i] + kNormalizeRound) >> kNormalizeShift);
+    }
+    std::fill(accumulator_.begin(), accumulator_.end(), 0);
+    kernels_.horizontal(normalized_.data(), horizontal_taps_, image_.scanLine(target_row_++));
+}
+
+QImage area_scaler::take_image()
+{
+    if (!is_valid() || target_row_ < target_size_.height())
+    {
+        return QImage();
+    }
+    return std::move(image_);
+}
+
+QImage area_scaler::scaled(const QImage& image, const QSize& bound, cpu_features::simd_level level)
+{
+    const QSize target = image.size().scaled(bound, Qt::KeepAspectRatio);
+    if (image.isNull() || target.isEmpty())
+    {
+        return QImage();
+    }
+    if (target == image.size())
+    {
+        return image;
+    }
+    if (target.width() > image.width() || target.height() > image.height())
+    {
+        return image.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    const QImage source = image.format() == QImage::Format_RGB32 ? image : pixel_kernels::to_premultiplied(image, level);
+    area_scaler scaler(source.size(), target, source.format(), level);
+    if (!scaler.is_valid())
+    {
+        return image.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    for (int y = 0; y < source.height(); ++y)
+    {
+        scaler.push_row(source.constScanLine(y));
+    }
+
+    QImage result = scaler.take_image();
+    result.setDevicePixelRatio(image.devicePixelRatio());
+    return result;
+}
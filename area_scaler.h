@@ -0,0 +1,59 @@
+#ifndef IMAGE_VIEWER_AREA_SCALER_H
+#define IMAGE_VIEWER_AREA_SCALER_H
+
+#include <QImage>
+#include <QSize>
+#include <vector>
+#include "cpu_features.h"
+
+class area_scaler
+{
+   public:
+    area_scaler(const QSize& source_size,
+                const QSize& target_size,
+                QImage::Format format,
+                cpu_features::simd_level level = cpu_features::best_simd_level());
+
+    area_scaler(const area_scaler&) = delete;
+    area_scaler& operator=(const area_scaler&) = delete;
+
+    [[nodiscard]] bool is_valid() const { return !image_.isNull(); }
+    void push_row(const uchar* row);
+    [[nodiscard]] int rows_pushed() const { return source_row_; }
+    [[nodiscard]] QImage take_image();
+
+    [[nodiscard]] static QImage scaled(const QImage& image, const QSize& bound, cpu_features::simd_level level = cpu_features::best_simd_level());
+
+   private:
+    struct tap_table
+    {
+        std::vector<int> first;
+        std::vector<int> count;
+        std::vector<int> offset;
+        std::vector<quint32> weights;
+    };
+
+    struct kernel_set
+    {
+        void (*accumulate)(const uchar* row, quint32 weight, quint32* acc, int values);
+        void (*horizontal)(const quint16* row, const tap_table& taps, uchar* out);
+    };
+
+    [[nodiscard]] static tap_table build_taps(int source_length, int target_length);
+    [[nodiscard]] static kernel_set kernels_for(cpu_features::simd_level level);
+    void finish_output_row();
+
+   private:
+    QSize source_size_;
+    QSize target_size_;
+    kernel_set kernels_{};
+    tap_table horizontal_taps_;
+    tap_table vertical_taps_;
+    std::vector<quint32> accumulator_;
+    std::vector<quint16> normalized_;
+    QImage image_;
+    int source_row_ = 0;
+    int target_row_ = 0;
+};
+
+#endif
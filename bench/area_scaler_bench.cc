@@ -0,0 +1,95 @@
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QImage>
+#include <QImageReader>
+#include <QTextStream>
+#include <array>
+#include "area_scaler.h"
+
+namespace
+{
+constexpr int kThumbnailWidth = 256;
+constexpr int kMaxSamples = 50;
+constexpr std::array<cpu_features::simd_level, 4> kLevels = {
+    cpu_features::simd_level::scalar, cpu_features::simd_level::sse41, cpu_features::simd_level::avx2, cpu_features::simd_level::neon};
+}
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    if (argc < 2)
+    {
+        out << "usage: area_scaler_bench <image folder>" << Qt::endl;
+        return 1;
+    }
+
+    QList<QImage> sources;
+    QDirIterator it(QString::fromLocal8Bit(argv[1]),
+                    {"*.jpg", "*.jpeg", "*.png", "*.bmp", "*.webp"},
+                    QDir::Files,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext() && sources.size() < kMaxSamples)
+    {
+        QImageReader reader(it.next());
+        reader.setAutoTransform(true);
+        const QImage image = reader.read();
+        if (!image.isNull() && image.width() > kThumbnailWidth)
+        {
+            sources.append(image.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+        }
+    }
+
+    if (sources.isEmpty())
+    {
+        out << "no decodable images wider than the thumbnail width found" << Qt::endl;
+        return 1;
+    }
+
+    const QSize bound(kThumbnailWidth, kThumbnailWidth * 4);
+    QElapsedTimer timer;
+    qint64 qt_ns = 0;
+    for (const QImage& source : sources)
+    {
+        timer.start();
+        const QImage scaled = source.scaled(bound, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        qt_ns += timer.nsecsElapsed();
+    }
+    out << QString("%1 images, %2 px wide thumbnails, best kernels: %3")
+               .arg(sources.size())
+               .arg(kThumbnailWidth)
+               .arg(cpu_features::simd_level_name(cpu_features::best_simd_level()))
+        << Qt::endl;
+    out << QString("%1 %2 us").arg("qt", -6).arg(static_cast<double>(qt_ns) / 1000.0 / sources.size(), 9, 'f', 1) << Qt::endl;
+
+    QList<QImage> reference;
+    for (const cpu_features::simd_level level : kLevels)
+    {
+        if (!cpu_features::supports(level))
+        {
+            continue;
+        }
+
+        qint64 ns = 0;
+        for (qsizetype i = 0; i < sources.size(); ++i)
+        {
+            timer.start();
+            const QImage scaled = area_scaler::scaled(sources[i], bound, level);
+            ns += timer.nsecsElapsed();
+
+            if (reference.size() <= i)
+            {
+                reference.append(scaled);
+            }
+            else if (scaled != reference[i])
+            {
+                out << cpu_features::simd_level_name(level) << " output differs from scalar" << Qt::endl;
+                return 1;
+            }
+        }
+        out << QString("%1 %2 us").arg(cpu_features::simd_level_name(level), -6).arg(static_cast<double>(ns) / 1000.0 / sources.size(), 9, 'f', 1) << Qt::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <QBuffer>
+#include <QByteArray>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QImage>
+#include <QImageReader>
+#include <QTextStream>
+#include <cstring>
+#include "thumbnail_codec.h"
+
+namespace
+{
+constexpr int kThumbnailWidth = 256;
+constexpr int kMaxSamples = 200;
+
+struct codec_totals
+{
+    qint64 bytes = 0;
+    qint64 encode_ns = 0;
+    qint64 decode_ns = 0;
+};
+
+void print_row(QTextStream& out, const QString& name, const codec_totals& totals, qint64 raw_bytes, int samples)
+{
+    out << QString("%1 size %2%  encode %3 us  decode %4 us")
+               .arg(name, -4)
+               .arg(100.0 * static_cast<double>(totals.bytes) / static_cast<double>(raw_bytes), 6, 'f', 1)
+               .arg(static_cast<double>(totals.encode_ns) / 1000.0 / samples, 9, 'f', 1)
+               .arg(static_cast<double>(totals.decode_ns) / 1000.0 / samples, 9, 'f', 1)
+        << Qt::endl;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    if (argc < 2)
+    {
+        out << "usage: thumbnail_codec_bench <image folder>" << Qt::endl;
+        return 1;
+    }
+
+    QList<QImage> thumbnails;
+    QDirIterator it(QString::fromLocal8Bit(argv[1]),
+                    {"*.jpg", "*.jpeg", "*.png", "*.bmp", "*.webp"},
+                    QDir::Files,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext() && thumbnails.size() < kMaxSamples)
+    {
+        QImageReader reader(it.next());
+        reader.setAutoTransform(true);
+        const QSize source_size = reader.size();
+        if (source_size.isValid() && reader.supportsOption(QImageIOHandler::ScaledSize))
+        {
+            reader.setScaledSize(source_size.scaled(kThumbnailWidth, source_size.height(), Qt::KeepAspectRatio));
+        }
+
+        QImage image = reader.read();
+        if (image.isNull())
+        {
+            continue;
+        }
+        image = image.scaledToWidth(kThumbnailWidth, Qt::SmoothTransformation).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        thumbnails.append(image);
+    }
+
+    if (thumbnails.isEmpty())
+    {
+        out << "no decodable images found" << Qt::endl;
+        return 1;
+    }
+
+    codec_totals png;
+    codec_totals qoi;
+    codec_totals raw;
+    qint64 raw_bytes = 0;
+    QElapsedTimer timer;
+
+    for (const QImage& image : thumbnails)
+    {
+        raw_bytes += image.sizeInBytes();
+
+        QByteArray png_data;
+        QBuffer png_buffer(&png_data);
+        png_buffer.open(QIODevice::WriteOnly);
+        timer.start();
+        image.save(&png_buffer, "PNG");
+        png.encode_ns += timer.nsecsElapsed();
+        png.bytes += png_data.size();
+        timer.start();
+        const QImage png_decoded = QImage::fromData(png_data, "PNG").convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        png.decode_ns += timer.nsecsElapsed();
+
+        QByteArray qoi_data(thumbnail_codec::max_encoded_size(image.width(), image.height()), Qt::Uninitialized);
+        timer.start();
+        const qsizetype qoi_bytes = thumbnail_codec::encode(
+            image.constBits(), image.width(), image.height(), image.bytesPerLine(), reinterpret_cast<uchar*>(qoi_data.data()));
+        qoi.encode_ns += timer.nsecsElapsed();
+        qoi.bytes += qoi_bytes;
+        QImage qoi_decoded(image.size(), image.format());
+        timer.start();
+        const bool qoi_ok = thumbnail_codec::decode(reinterpret_cast<const uchar*>(qoi_data.constData()),
+                                                    qoi_bytes,
+                                                    qoi_decoded.bits(),
+                                                    qoi_decoded.width(),
+                                                    qoi_decoded.height(),
+                                                    qoi_decoded.bytesPerLine());
+        qoi.decode_ns += timer.nsecsElapsed();
+
+        QImage raw_copy(image.size(), image.format());
+        timer.start();
+        std::memcpy(raw_copy.bits(), image.constBits(), static_cast<size_t>(image.sizeInBytes()));
+        raw.decode_ns += timer.nsecsElapsed();
+        raw.bytes += image.sizeInBytes();
+
+        if (!qoi_ok || qoi_decoded != image || png_decoded.isNull())
+        {
+            out << "round trip mismatch" << Qt::endl;
+            return 1;
+        }
+    }
+
+    out << QString("%1 thumbnails, %2 px wide, %3 KB raw").arg(thumbnails.size()).arg(kThumbnailWidth).arg(raw_bytes / 1024) << Qt::endl;
+    print_row(out, "png", png, raw_bytes, static_cast<int>(thumbnails.size()));
+    print_row(out, "qoi", qoi, raw_bytes, static_cast<int>(thumbnails.size()));
+    print_row(out, "raw", raw, raw_bytes, static_cast<int>(thumbnails.size()));
+    return 0;
+}
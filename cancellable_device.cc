@@ -0,0 +1,33 @@
+#include "cancellable_device.h"
+
+cancellable_device::cancellable_device(QIODevice* source, const std::atomic<bool>* cancelled, QObject* parent)
+    : QIODevice(parent), source_(source), cancelled_(cancelled)
+{
+}
+
+bool cancellable_device::open(OpenMode mode)
+{
+    if ((mode & QIODevice::WriteOnly) != 0 || source_ == nullptr || !source_->isReadable())
+    {
+        return false;
+    }
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+bool cancellable_device::isSequential() const { return source_->isSequential(); }
+
+qint64 cancellable_device::size() const { return source_->size(); }
+
+bool cancellable_device::seek(qint64 pos) { return QIODevice::seek(pos) && source_->seek(pos); }
+
+qint64 cancellable_device::readData(char* data, qint64 max_size)
+{
+    if (cancelled_ != nullptr && cancelled_->load(std::memory_order_relaxed))
+    {
+        setErrorString("cancelled");
+        return -1;
+    }
+    return source_->read(data, max_size);
+}
+
+qint64 cancellable_device::writeData(const char* /*data*/, qint64 /*max_size*/) { return -1; }
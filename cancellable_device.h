@@ -0,0 +1,26 @@
+#ifndef IMAGE_VIEWER_CANCELLABLE_DEVICE_H
+#define IMAGE_VIEWER_CANCELLABLE_DEVICE_H
+
+#include <QIODevice>
+#include <atomic>
+
+class cancellable_device : public QIODevice
+{
+   public:
+    cancellable_device(QIODevice* source, const std::atomic<bool>* cancelled, QObject* parent = nullptr);
+
+    bool open(OpenMode mode) override;
+    [[nodiscard]] bool isSequential() const override;
+    [[nodiscard]] qint64 size() const override;
+    bool seek(qint64 pos) override;
+
+   protected:
+    qint64 readData(char* data, qint64 max_size) override;
+    qint64 writeData(const char* data, qint64 max_size) override;
+
+   private:
+    QIODevice* source_;
+    const std::atomic<bool>* cancelled_;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <array>
+#include <QDataStream>
+#include "color_signature.h"
+
+namespace
+{
+constexpr int kMaxSamplesPerAxis = 64;
+constexpr int kRenderWidth = 32;
+}
+
+color_signature color_signature::from_image(const QImage& image)
+{
+    color_signature signature;
+    if (image.isNull())
+    {
+        return signature;
+    }
+
+    const QImage source = image.format() == QImage::Format_ARGB32_Premultiplied || image.format() == QImage::Format_RGB32 ||
+                                  image.format() == QImage::Format_ARGB32
+                              ? image
+                              : image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    const int step_x = std::max(1, source.width() / kMaxSamplesPerAxis);
+    const int step_y = std::max(1, source.height() / kMaxSamplesPerAxis);
+    std::array<std::array<quint64, 4>, kGrid * kGrid> sums{};
+
+    for (int y = 0; y < source.height(); y += step_y)
+    {
+        const auto* row = reinterpret_cast<const QRgb*>(source.constScanLine(y));
+        const int cell_y = std::min(kGrid - 1, y * kGrid / source.height());
+        for (int x = 0; x < source.width(); x += step_x)
+        {
+            const QRgb pixel = row[x];
+            auto& sum = sums[(cell_y * kGrid) + std::min(kGrid - 1, x * kGrid / source.width())];
+            sum[0] += qRed(pixel);
+            sum[1] += qGreen(pixel);
+            sum[2] += qBlue(pixel);
+            sum[3] += 1;
+        }
+    }
+
+    for (size_t i = 0; i < sums.size(); ++i)
+    {
+        const auto& sum = sums[i];
+        const quint64 count = std::max<quint64>(1, sum[3]);
+        signature.cells[i] = qRgb(static_cast<int>(sum[0] / count), static_cast<int>(sum[1] / count), static_cast<int>(sum[2] / count));
+    }
+    signature.valid = true;
+    return signature;
+}
+
+QImage color_signature::render(const QSize& aspect) const
+{
+    QImage grid(kGrid, kGrid, QImage::Format_RGB32);
+    for (int y = 0; y < kGrid; ++y)
+    {
+        auto* row = reinterpret_cast<QRgb*>(grid.scanLine(y));
+        for (int x = 0; x < kGrid; ++x)
+        {
+            row[x] = cells[static_cast<size_t>((y * kGrid) + x)];
+        }
+    }
+
+    const int height = aspect.isEmpty() ? kRenderWidth : std::max(1, kRenderWidth * aspect.height() / aspect.width());
+    return grid.scaled(kRenderWidth, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+QDataStream& operator<<(QDataStream& stream, const color_signature& signature)
+{
+    for (const QRgb cell : signature.cells)
+    {
+        stream << cell;
+    }
+    return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, color_signature& signature)
+{
+    for (QRgb& cell : signature.cells)
+    {
+        stream >> cell;
+    }
+    signature.valid = stream.status() == QDataStream::Ok;
+    return stream;
+}
@@ -0,0 +1,25 @@
+#ifndef IMAGE_VIEWER_COLOR_SIGNATURE_H
+#define IMAGE_VIEWER_COLOR_SIGNATURE_H
+
+#include <QImage>
+#include <QRgb>
+#include <QSize>
+#include <array>
+
+class QDataStream;
+
+struct color_signature
+{
+    static constexpr int kGrid = 4;
+
+    std::array<QRgb, kGrid * kGrid> cells{};
+    bool valid = false;
+
+    [[nodiscard]] static color_signature from_image(const QImage& image);
+    [[nodiscard]] QImage render(const QSize& aspect) const;
+};
+
+QDataStream& operator<<(QDataStream& stream, const color_signature& signature);
+QDataStream& operator>>(QDataStream& stream, color_signature& signature);
+
+#endif
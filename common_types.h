@@ -6,18 +6,24 @@
 #include <QList>
 #include <QRectF>
 #include <QMetaType>
+#include <QImage>
+#include "color_signature.h"
 
 struct image_meta
 {
     QString path;
+    quint32 path_id = 0;
     QSize original_size;
+    color_signature signature;
 };
 
 struct layout_model
 {
     int index;
     QString path;
+    quint32 path_id = 0;
     QSize original_size;
+    color_signature signature;
     QRectF layout_rect;
 };
 
@@ -25,8 +31,28 @@ struct load_task
 {
     quint64 id;
     QString path;
+    quint32 path_id;
     QSize target_size;
     int session_id;
+    int priority = 0;
+    qreal device_pixel_ratio = 1.0;
+    bool preview = false;
+};
+
+struct task_priority
+{
+    quint64 id;
+    int priority;
+};
+
+struct thumbnail_result
+{
+    quint64 id = 0;
+    QString path;
+    QImage image;
+    int session_id = 0;
+    bool preview = false;
+    bool broken = false;
 };
 
 struct layout_result
@@ -42,6 +68,7 @@ struct layout_result
 
 Q_DECLARE_METATYPE(load_task)
 Q_DECLARE_METATYPE(QList<load_task>)
+Q_DECLARE_METATYPE(QList<task_priority>)
 Q_DECLARE_METATYPE(layout_result)
 
 const int kColumnMargin = 10;
@@ -0,0 +1,125 @@
+#include "compressed_cache.h"
+#include "thumbnail_codec.h"
+
+compressed_cache::compressed_cache(qint64 max_bytes) : max_bytes_(max_bytes) {}
+
+bool compressed_cache::find(quint64 key, QImage& image)
+{
+    QByteArray payload;
+    int width = 0;
+    int height = 0;
+    QImage::Format format = QImage::Format_Invalid;
+    {
+        QMutexLocker locker(&mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        lru_.splice(lru_.begin(), lru_, it->lru_it);
+        payload = it->payload;
+        width = it->width;
+        height = it->height;
+        format = it->format;
+    }
+
+    QImage decoded(width, height, format);
+    if (decoded.isNull() || !thumbnail_codec::decode(reinterpret_cast<const uchar*>(payload.constData()), payload.size(), decoded.bits(),
+                                                     width, height, decoded.bytesPerLine()))
+    {
+        QMutexLocker locker(&mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            remove(it);
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    image = std::move(decoded);
+    return true;
+}
+
+bool compressed_cache::contains(quint64 key) const
+{
+    QMutexLocker locker(&mutex_);
+    return entries_.contains(key);
+}
+
+void compressed_cache::insert(quint64 key, const QImage& image)
+{
+    if (image.isNull() || image.depth() != 32 || contains(key))
+    {
+        return;
+    }
+
+    QByteArray payload(thumbnail_codec::max_encoded_size(image.width(), image.height()), Qt::Uninitialized);
+    const qsizetype encoded_bytes = thumbnail_codec::encode(image.constBits(), image.width(), image.height(), image.bytesPerLine(),
+                                                            reinterpret_cast<uchar*>(payload.data()));
+    if (encoded_bytes <= 0 || encoded_bytes >= image.sizeInBytes())
+    {
+        return;
+    }
+    payload.resize(encoded_bytes);
+    payload.squeeze();
+
+    QMutexLocker locker(&mutex_);
+    if (encoded_bytes > max_bytes_ / 4 || entries_.contains(key))
+    {
+        return;
+    }
+
+    lru_.push_front(key);
+    entries_.insert(key, entry{payload, image.width(), image.height(), image.format(), image.sizeInBytes(), lru_.begin()});
+    bytes_ += encoded_bytes;
+    raw_bytes_ += image.sizeInBytes();
+    evict();
+}
+
+void compressed_cache::clear()
+{
+    QMutexLocker locker(&mutex_);
+    entries_.clear();
+    lru_.clear();
+    bytes_ = 0;
+    raw_bytes_ = 0;
+}
+
+void compressed_cache::set_max_bytes(qint64 max_bytes)
+{
+    QMutexLocker locker(&mutex_);
+    max_bytes_ = max_bytes;
+    evict();
+}
+
+compressed_cache::cache_stats compressed_cache::stats() const
+{
+    cache_stats result;
+    result.hits = hits_.load(std::memory_order_relaxed);
+    result.misses = misses_.load(std::memory_order_relaxed);
+
+    QMutexLocker locker(&mutex_);
+    result.bytes = bytes_;
+    result.raw_bytes = raw_bytes_;
+    result.entries = static_cast<int>(entries_.size());
+    return result;
+}
+
+void compressed_cache::evict()
+{
+    while (bytes_ > max_bytes_ && !lru_.empty())
+    {
+        remove(entries_.find(lru_.back()));
+    }
+}
+
+void compressed_cache::remove(QHash<quint64, entry>::iterator it)
+{
+    bytes_ -= it->payload.size();
+    raw_bytes_ -= it->raw_bytes;
+    lru_.erase(it->lru_it);
+    entries_.erase(it);
+}
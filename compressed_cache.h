@@ -0,0 +1,60 @@
+#ifndef IMAGE_VIEWER_COMPRESSED_CACHE_H
+#define IMAGE_VIEWER_COMPRESSED_CACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <atomic>
+#include <list>
+
+class compressed_cache
+{
+   public:
+    struct cache_stats
+    {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        qint64 bytes = 0;
+        qint64 raw_bytes = 0;
+        int entries = 0;
+    };
+
+    explicit compressed_cache(qint64 max_bytes);
+
+    compressed_cache(const compressed_cache&) = delete;
+    compressed_cache& operator=(const compressed_cache&) = delete;
+
+    [[nodiscard]] bool find(quint64 key, QImage& image);
+    [[nodiscard]] bool contains(quint64 key) const;
+    void insert(quint64 key, const QImage& image);
+    void clear();
+    void set_max_bytes(qint64 max_bytes);
+    [[nodiscard]] cache_stats stats() const;
+
+   private:
+    struct entry
+    {
+        QByteArray payload;
+        int width = 0;
+        int height = 0;
+        QImage::Format format = QImage::Format_Invalid;
+        qint64 raw_bytes = 0;
+        std::list<quint64>::iterator lru_it;
+    };
+
+    void evict();
+    void remove(QHash<quint64, entry>::iterator it);
+
+   private:
+    mutable QMutex mutex_;
+    QHash<quint64, entry> entries_;
+    std::list<quint64> lru_;
+    qint64 max_bytes_ = 0;
+    qint64 bytes_ = 0;
+    qint64 raw_bytes_ = 0;
+    std::atomic<quint64> hits_{0};
+    std::atomic<quint64> misses_{0};
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "cpu_features.h"
+
+namespace
+{
+cpu_features::simd_level detect_simd_level()
+{
+#if defined(IMAGEVIEWER_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return cpu_features::simd_level::avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return cpu_features::simd_level::sse41;
+    }
+    return cpu_features::simd_level::scalar;
+#elif defined(IMAGEVIEWER_SIMD_NEON)
+    return cpu_features::simd_level::neon;
+#else
+    return cpu_features::simd_level::scalar;
+#endif
+}
+}
+
+namespace cpu_features
+{
+simd_level best_simd_level()
+{
+    static const simd_level best = detect_simd_level();
+    return best;
+}
+
+bool supports(simd_level level)
+{
+    const simd_level best = best_simd_level();
+    switch (level)
+    {
+        case simd_level::scalar:
+            return true;
+        case simd_level::sse41:
+            return best == simd_level::sse41 || best == simd_level::avx2;
+        case simd_level::avx2:
+        case simd_level::neon:
+            return best == level;
+    }
+    return false;
+}
+
+const char* simd_level_name(simd_level level)
+{
+    switch (level)
+    {
+        case simd_level::scalar:
+            return "scalar";
+        case simd_level::sse41:
+            return "sse4.1";
+        case simd_level::avx2:
+            return "avx2";
+        case simd_level::neon:
+            return "neon";
+    }
+    return "";
+}
+}
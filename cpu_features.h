@@ -0,0 +1,25 @@
+#ifndef IMAGE_VIEWER_CPU_FEATURES_H
+#define IMAGE_VIEWER_CPU_FEATURES_H
+
+#if defined(__x86_64__) || defined(__i386__)
+#define IMAGEVIEWER_SIMD_X86
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define IMAGEVIEWER_SIMD_NEON
+#endif
+
+namespace cpu_features
+{
+enum class simd_level
+{
+    scalar,
+    sse41,
+    avx2,
+    neon
+};
+
+[[nodiscard]] simd_level best_simd_level();
+[[nodiscard]] bool supports(simd_level level);
+[[nodiscard]] const char* simd_level_name(simd_level level);
+}
+
+#endif
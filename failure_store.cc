@@ -0,0 +1,45 @@
+#include <QDateTime>
+#include "failure_store.h"
+#include "keyed_record_store.h"
+
+namespace
+{
+constexpr quint32 kStoreMagic = 0x4641494C;
+constexpr quint32 kStoreVersion = 2;
+// A failure is retried after this long, in case a codec that can read the file has since been installed.
+constexpr qint64 kRetryAfterMs = 7LL * 24 * 60 * 60 * 1000;
+
+struct failure_marker
+{
+    qint64 recorded_at = 0;
+};
+
+QDataStream& operator<<(QDataStream& stream, const failure_marker& marker) { return stream << marker.recorded_at; }
+
+QDataStream& operator>>(QDataStream& stream, failure_marker& marker) { return stream >> marker.recorded_at; }
+
+bool expired(const failure_marker& marker) { return QDateTime::currentMSecsSinceEpoch() - marker.recorded_at >= kRetryAfterMs; }
+
+keyed_record_store<failure_marker>& store()
+{
+    static keyed_record_store<failure_marker> s(kStoreMagic, kStoreVersion, "decode_failures.bin");
+    return s;
+}
+}
+
+bool failure_store::contains(const QString& path, qint64 modified_time, qint64 file_size)
+{
+    failure_marker marker;
+    return store().find(path, modified_time, file_size, marker) && !expired(marker);
+}
+
+void failure_store::insert(const QString& path, qint64 modified_time, qint64 file_size)
+{
+    store().insert(path, modified_time, file_size, {QDateTime::currentMSecsSinceEpoch()});
+}
+
+void failure_store::prune() { store().prune(expired); }
+
+void failure_store::clear() { store().clear(); }
+
+void failure_store::flush() { store().flush(); }
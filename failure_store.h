@@ -0,0 +1,16 @@
+#ifndef IMAGE_VIEWER_FAILURE_STORE_H
+#define IMAGE_VIEWER_FAILURE_STORE_H
+
+#include <QString>
+
+class failure_store
+{
+   public:
+    static bool contains(const QString& path, qint64 modified_time, qint64 file_size);
+    static void insert(const QString& path, qint64 modified_time, qint64 file_size);
+    static void prune();
+    static void clear();
+    static void flush();
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "file_scanner.h"
+#include "path_registry.h"
+#include "signature_store.h"
 #include <algorithm>
 #include <QCollator>
 #include <QDirIterator>
@@ -115,7 +117,9 @@ void file_scanner::start_scan(const QString& dir_path, int session_id, int sort_
                 continue;
             }
 
-            batch.append({scanned_images[j].path, size});
+            image_meta meta{scanned_images[j].path, path_registry::intern(scanned_images[j].path), size, {}};
+            signature_store::find(meta.path, scanned_images[j].modified_time, scanned_images[j].file_size, meta.signature);
+            batch.append(meta);
             total_count++;
         }
 
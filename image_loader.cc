@@ -1,20 +1,131 @@
+#include <array>
 #include <cmath>
+#include <algorithm>
+#include <utility>
 #include <QCryptographicHash>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QMetaObject>
 #include <QImageReader>
 #include <QStandardPaths>
+#include <QHash>
+#include <QtEndian>
 #include "image_loader.h"
+#include "area_scaler.h"
+#include "cancellable_device.h"
+#include "failure_store.h"
+#include "image_source.h"
+#include "path_registry.h"
+#include "pixel_kernels.h"
+#include "signature_store.h"
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+#include "jpeg_decoder.h"
+#endif
+#ifdef IMAGEVIEWER_HAVE_LIBPNG
+#include "png_decoder.h"
+#endif
+
+namespace
+{
+constexpr size_t kResultRingCapacity = 1024;
+constexpr int kPreviewDivisor = 4;
+constexpr int kDefaultReadAheadDepth = 8;
+constexpr int kDefaultBackgroundCpuShare = 25;
+constexpr int kBackgroundPollMs = 200;
+constexpr int kIdleMaintenanceMs = 10000;
+constexpr qint64 kMaxBackgroundPauseMs = 1000;
+constexpr qint64 kBackgroundProgressIntervalMs = 250;
+constexpr qint64 kMaxMemoryCacheBytes = 200LL * 1024 * 1024;
+constexpr int kCompressedCacheShareDivisor = 3;
+constexpr qint64 kMaxDiskCacheBytes = 512LL * 1024 * 1024;
+constexpr std::array<int, 7> kThumbnailBucketWidths = {192, 256, 384, 512, 768, 1024, 1536};
+
+bool task_order(const load_task& left, const load_task& right)
+{
+    if (left.priority != right.priority)
+    {
+        return left.priority > right.priority;
+    }
+    return left.id > right.id;
+}
+
+quint64 memory_cache_key(quint32 path_id, int bucket_width) { return (static_cast<quint64>(path_id) << 32) | static_cast<quint32>(bucket_width); }
+
+void remember_signature(const QString& path, const QFileInfo& file_info, const QImage& image)
+{
+    const qint64 modified_time = file_info.lastModified().toMSecsSinceEpoch();
+    color_signature signature;
+    if (!signature_store::find(path, modified_time, file_info.size(), signature))
+    {
+        signature_store::insert(path, modified_time, file_info.size(), color_signature::from_image(image));
+    }
+}
+
+bool known_failure(const QString& path, const QFileInfo& file_info)
+{
+    return failure_store::contains(path, file_info.lastModified().toMSecsSinceEpoch(), file_info.size());
+}
+
+void remember_failure(const QString& path, const QFileInfo& file_info)
+{
+    if (file_info.exists())
+    {
+        failure_store::insert(path, file_info.lastModified().toMSecsSinceEpoch(), file_info.size());
+    }
+}
+
+QSize stored_size(const QSize& size, QImageIOHandler::Transformations transformation)
+{
+    return transformation.testFlag(QImageIOHandler::TransformationRotate90) ? size.transposed() : size;
+}
+
+load_task bucketed_task(const load_task& task)
+{
+    if (task.target_size.isEmpty())
+    {
+        return task;
+    }
+
+    const int requested_width = task.target_size.width();
+    auto bucket_it = std::lower_bound(kThumbnailBucketWidths.begin(), kThumbnailBucketWidths.end(), requested_width);
+    const int bucket_width = bucket_it == kThumbnailBucketWidths.end() ? kThumbnailBucketWidths.back() : *bucket_it;
+    const int bucket_height =
+        std::max(1, static_cast<int>(std::lround(static_cast<double>(task.target_size.height()) * bucket_width / requested_width)));
+
+    load_task bucketed = task;
+    bucketed.target_size = QSize(bucket_width, bucket_height);
+    return bucketed;
+}
+
+// The per-file PNG cache predates the pack store; a large one takes long enough to delete that it must stay off the GUI
+// thread.
+void remove_legacy_disk_cache()
+{
+    QDir legacy_dir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails");
+    if (legacy_dir.exists())
+    {
+        legacy_dir.removeRecursively();
+    }
+}
+}
 
-image_loader::image_loader(QObject* parent) : QObject(parent), abort_(false)
+image_loader::image_loader(int worker_count, QObject* parent)
+    : QObject(parent),
+      cache_(kMaxMemoryCacheBytes - kMaxMemoryCacheBytes / kCompressedCacheShareDivisor),
+      compressed_cache_(kMaxMemoryCacheBytes / kCompressedCacheShareDivisor),
+      background_share_(kDefaultBackgroundCpuShare),
+      abort_(false),
+      results_(kResultRingCapacity)
 {
-    cache_.setMaxCost(200L * 1024 * 1024);
-    disk_cache_dir_ = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
-    QDir().mkpath(disk_cache_dir_);
-    cleanup_disk_cache();
+    cache_.set_eviction_sink([this](quint64 key, const QImage& image) { compressed_cache_.insert(key, image); });
+    worker_count_ = worker_count > 0 ? worker_count : std::max(1, QThread::idealThreadCount());
+
+    const QString cache_root = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    disk_cache_ = std::make_unique<thumbnail_store>(cache_root + "/thumbnail_store", kMaxDiskCacheBytes);
+    read_ahead_ = std::make_unique<read_ahead>([this](const load_task& task) { return needs_source(task); }, kDefaultReadAheadDepth);
 }
 
 image_loader::~image_loader() { stop(); }
@@ -22,261 +133,765 @@ image_loader::~image_loader() { stop(); }
 void image_loader::stop()
 {
     abort_ = true;
-    condition_.wakeAll();
+    wakeups_.release(static_cast<int>(workers_.size()));
+    background_wakeups_.release();
+
+    for (QThread* worker : workers_)
+    {
+        worker->wait();
+        delete worker;
+    }
+    workers_.clear();
+
+    if (background_worker_ != nullptr)
+    {
+        background_worker_->wait();
+        delete background_worker_;
+        background_worker_ = nullptr;
+    }
+
+    disk_cache_->flush();
+    signature_store::flush();
+    failure_store::flush();
 }
 
-QString image_loader::memory_cache_key(const load_task& task) const
+quint64 image_loader::disk_cache_key(const QFileInfo& file_info, int bucket_width) const
 {
-    return QString("%1|%2x%3").arg(task.path).arg(task.target_size.width()).arg(task.target_size.height());
+    const QString cache_seed = QString("%1|%2|%3|%4")
+                                   .arg(file_info.absoluteFilePath())
+                                   .arg(file_info.lastModified().toMSecsSinceEpoch())
+                                   .arg(file_info.size())
+                                   .arg(bucket_width);
+    const QByteArray hash = QCryptographicHash::hash(cache_seed.toUtf8(), QCryptographicHash::Sha1);
+    return qFromLittleEndian<quint64>(hash.constData());
 }
 
-QString image_loader::disk_cache_path(const load_task& task) const
+bool image_loader::find_in_memory(quint64 key, QImage& image)
 {
-    QFileInfo file_info(task.path);
-    const QString cache_seed =
-        QString("%1|%2|%3|%4x%5")
-            .arg(file_info.absoluteFilePath())
-            .arg(file_info.lastModified().toMSecsSinceEpoch())
-            .arg(file_info.size())
-            .arg(task.target_size.width())
-            .arg(task.target_size.height());
-    const QByteArray hash = QCryptographicHash::hash(cache_seed.toUtf8(), QCryptographicHash::Sha1).toHex();
-    return disk_cache_dir_ + "/" + QString::fromLatin1(hash) + ".png";
+    if (cache_.find(key, image))
+    {
+        return true;
+    }
+    if (!compressed_cache_.find(key, image))
+    {
+        return false;
+    }
+    cache_.insert(key, image);
+    return true;
 }
 
-QImage image_loader::load_disk_cached_image(const load_task& task) const
+QImage image_loader::load_from_larger_bucket(const load_task& task, const QFileInfo& file_info)
 {
-    QImageReader reader(disk_cache_path(task));
-    reader.setAutoTransform(true);
-    return reader.read();
+    const int bucket_width = task.target_size.width();
+    for (const int larger_width : kThumbnailBucketWidths)
+    {
+        if (larger_width <= bucket_width)
+        {
+            continue;
+        }
+
+        QImage larger;
+        if (!find_in_memory(memory_cache_key(task.path_id, larger_width), larger))
+        {
+            larger = disk_cache_->find(disk_cache_key(file_info, larger_width));
+        }
+
+        if (!larger.isNull())
+        {
+            return area_scaler::scaled(larger, task.target_size);
+        }
+    }
+    return QImage();
 }
 
-void image_loader::save_disk_cached_image(const load_task& task, const QImage& image)
+void image_loader::request_thumbnails(const QList<load_task>& tasks)
 {
-    if (image.isNull())
+    if (!tasks.isEmpty())
     {
-        return;
+        submit({submission::kind::load, tasks, {}, {}});
     }
+}
+
+void image_loader::request_background(const QList<load_task>& tasks) { submit({submission::kind::background, tasks, {}, {}}); }
 
-    image.save(disk_cache_path(task), "PNG");
-    cleanup_disk_cache();
+void image_loader::update_priorities(const QList<task_priority>& priorities)
+{
+    if (!priorities.isEmpty())
+    {
+        submit({submission::kind::reprioritize, {}, priorities, {}});
+    }
 }
 
-void image_loader::cleanup_disk_cache()
+void image_loader::cancel_thumbnails(const QList<quint64>& ids)
 {
-    constexpr qint64 kMaxDiskCacheBytes = 512LL * 1024 * 1024;
-    constexpr int kMaxDiskCacheFiles = 2000;
+    if (!ids.isEmpty())
+    {
+        submit({submission::kind::cancel, {}, {}, ids});
+    }
+}
 
-    QDir cache_dir(disk_cache_dir_);
-    QFileInfoList files =
-        cache_dir.entryInfoList(QStringList() << "*.png", QDir::Files, QDir::Time | QDir::Reversed);
+void image_loader::clear_all() { submit({submission::kind::clear, {}, {}, {}}); }
 
-    qint64 total_size = 0;
-    for (const QFileInfo& file_info : files)
+void image_loader::submit(submission&& request)
+{
+    const int wakeups = request.type == submission::kind::load ? std::min(static_cast<int>(request.tasks.size()), worker_count_) : 1;
+    submissions_.push(std::move(request));
+
+    if (mutex_.tryLock())
     {
-        total_size += file_info.size();
+        const submission_outcome outcome = apply_submissions();
+        mutex_.unlock();
+        deliver(outcome);
     }
+    wakeups_.release(wakeups);
+}
 
-    while ((total_size > kMaxDiskCacheBytes || files.size() > kMaxDiskCacheFiles) && !files.isEmpty())
+image_loader::submission_outcome image_loader::apply_submissions()
+{
+    submission_outcome outcome;
+    submissions_.consume_all(
+        [this, &outcome](submission&& request)
+        {
+            switch (request.type)
+            {
+                case submission::kind::load:
+                    apply_load(request.tasks, outcome);
+                    break;
+                case submission::kind::background:
+                    apply_background(request.tasks);
+                    break;
+                case submission::kind::reprioritize:
+                    apply_priorities(request.priorities);
+                    break;
+                case submission::kind::cancel:
+                    apply_cancel(request.ids);
+                    break;
+                case submission::kind::clear:
+                    apply_clear();
+                    break;
+                case submission::kind::budget:
+                    pending_budget_ = request.bytes;
+                    break;
+            }
+        });
+
+    return outcome;
+}
+
+void image_loader::deliver(const submission_outcome& outcome)
+{
+    if (outcome.has_results)
     {
-        QFileInfo file_info = files.takeFirst();
-        total_size -= file_info.size();
-        QFile::remove(file_info.absoluteFilePath());
+        notify_results();
     }
 }
 
-void image_loader::request_thumbnails(const QList<load_task>& tasks)
+void image_loader::apply_load(const QList<load_task>& tasks, submission_outcome& outcome)
 {
-    QMutexLocker locker(&mutex_);
-    bool has_new_tasks = false;
-    for (const auto& task : tasks)
+    for (const auto& requested_task : tasks)
     {
-        if (pending_cancels_.contains(task.path))
+        const load_task task = bucketed_task(requested_task);
+        const quint64 cache_key = memory_cache_key(task.path_id, task.target_size.width());
+        QImage cached;
+        if (cache_.find(cache_key, cached))
         {
-            pending_cancels_.remove(task.path);
+            thumbnail_result result{task.id, task.path, cached, task.session_id};
+            if (results_.try_push(std::move(result)))
+            {
+                outcome.has_results = true;
+                continue;
+            }
         }
 
-        const QString cache_key = memory_cache_key(task);
-        if (cache_.contains(cache_key))
+        task_queue_.push_back(task);
+        std::push_heap(task_queue_.begin(), task_queue_.end(), task_order);
+        if (background_cancelled_ != nullptr)
         {
-            emit thumbnail_loaded(task.id, task.path, *cache_.object(cache_key), task.session_id);
-            continue;
+            background_cancelled_->store(true);
         }
+    }
+}
 
-        task_queue_.prepend(task);
-        has_new_tasks = true;
+void image_loader::apply_background(const QList<load_task>& tasks)
+{
+    ++background_generation_;
+    if (background_cancelled_ != nullptr)
+    {
+        background_cancelled_->store(true);
     }
 
-    QList<QString> dropped_paths;
-    while (task_queue_.size() > 200)
+    background_queue_.clear();
+    for (const auto& task : tasks)
     {
-        load_task task = task_queue_.takeLast();
-        dropped_paths.append(task.path);
+        background_queue_.push_back(bucketed_task(task));
     }
+    background_done_ = 0;
+    background_total_ = static_cast<int>(background_queue_.size());
+    background_wakeups_.release();
+}
 
-    if (!dropped_paths.isEmpty())
+void image_loader::apply_priorities(const QList<task_priority>& priorities)
+{
+    QHash<quint64, int> priority_by_id;
+    priority_by_id.reserve(priorities.size());
+    for (const auto& entry : priorities)
     {
-        locker.unlock();
-        emit tasks_dropped(dropped_paths);
-        locker.relock();
+        priority_by_id.insert(entry.id, entry.priority);
     }
 
-    if (has_new_tasks)
+    bool changed = false;
+    for (auto& task : task_queue_)
     {
-        condition_.wakeOne();
+        auto it = priority_by_id.constFind(task.id);
+        if (it != priority_by_id.constEnd() && it.value() != task.priority)
+        {
+            task.priority = it.value();
+            changed = true;
+        }
+    }
+
+    if (changed)
+    {
+        std::make_heap(task_queue_.begin(), task_queue_.end(), task_order);
     }
 }
 
-void image_loader::cancel_thumbnails(const QList<QString>& paths)
+void image_loader::apply_cancel(const QList<quint64>& ids)
 {
-    QMutexLocker locker(&mutex_);
-    for (const auto& path : paths)
+    const QSet<quint64> cancelled_ids(ids.begin(), ids.end());
+    read_ahead_->discard(ids);
+    for (const quint64 id : cancelled_ids)
+    {
+        auto it = in_flight_.constFind(id);
+        if (it != in_flight_.constEnd())
+        {
+            it.value()->store(true);
+        }
+    }
+
+    const auto removed = std::remove_if(
+        task_queue_.begin(), task_queue_.end(), [&cancelled_ids](const load_task& task) { return cancelled_ids.contains(task.id); });
+    if (removed != task_queue_.end())
     {
-        pending_cancels_.insert(path);
+        task_queue_.erase(removed, task_queue_.end());
+        std::make_heap(task_queue_.begin(), task_queue_.end(), task_order);
     }
 }
 
-void image_loader::clear_all()
+void image_loader::apply_clear()
 {
-    QMutexLocker locker(&mutex_);
     task_queue_.clear();
-    pending_cancels_.clear();
+    apply_background({});
+    read_ahead_->clear();
+    for (const auto& token : std::as_const(in_flight_))
+    {
+        token->store(true);
+    }
 }
 
-void image_loader::clear_cache()
+bool image_loader::take_result(thumbnail_result& result)
 {
+    if (results_.try_pop(result))
     {
-        QMutexLocker locker(&mutex_);
-        cache_.clear();
+        return true;
     }
 
-    QDir cache_dir(disk_cache_dir_);
-    const QFileInfoList files = cache_dir.entryInfoList(QStringList() << "*.png", QDir::Files);
-    for (const QFileInfo& file_info : files)
+    results_signalled_.store(false);
+    if (results_.try_pop(result))
+    {
+        results_signalled_.store(true);
+        return true;
+    }
+    return false;
+}
+
+void image_loader::publish(const load_task& task, const QImage& image, bool preview)
+{
+    thumbnail_result result{task.id, task.path, image, task.session_id, preview};
+    push_result(std::move(result));
+}
+
+void image_loader::publish_broken(const load_task& task)
+{
+    thumbnail_result result{task.id, task.path, QImage(), task.session_id};
+    result.broken = true;
+    push_result(std::move(result));
+}
+
+void image_loader::push_result(thumbnail_result&& result)
+{
+    while (!results_.try_push(std::move(result)))
+    {
+        if (abort_)
+        {
+            return;
+        }
+        QThread::msleep(1);
+    }
+    notify_results();
+}
+
+void image_loader::notify_results()
+{
+    if (!results_signalled_.exchange(true))
+    {
+        emit results_ready();
+    }
+}
+
+std::vector<thumbnail_cache::shard_stats> image_loader::memory_cache_stats() const { return cache_.stats(); }
+
+compressed_cache::cache_stats image_loader::compressed_cache_stats() const { return compressed_cache_.stats(); }
+
+void image_loader::set_memory_cache_budget(qint64 bytes) { submit({submission::kind::budget, {}, {}, {}, bytes}); }
+
+// Runs on a worker outside mutex_: a shrink walks every shard and frees images, which the GUI thread must not wait on.
+void image_loader::apply_budget(qint64 bytes)
+{
+    const qint64 compressed_bytes = bytes / kCompressedCacheShareDivisor;
+    compressed_cache_.set_max_bytes(compressed_bytes);
+    cache_.set_max_bytes(bytes - compressed_bytes);
+}
+
+void image_loader::set_read_ahead_depth(int depth) { read_ahead_->set_depth(depth); }
+
+void image_loader::set_background_cpu_share(int percent) { background_share_.store(std::clamp(percent, 0, 100)); }
+
+bool image_loader::needs_source(const load_task& task) const
+{
+    const int bucket_width = task.target_size.width();
+    const quint64 key = memory_cache_key(task.path_id, bucket_width);
+    if (cache_.contains(key) || compressed_cache_.contains(key))
     {
-        QFile::remove(file_info.absoluteFilePath());
+        return false;
     }
+    const QFileInfo file_info(task.path);
+    return !disk_cache_->contains(disk_cache_key(file_info, bucket_width)) && !known_failure(task.path, file_info);
+}
+
+void image_loader::clear_cache()
+{
+    cache_.clear();
+    compressed_cache_.clear();
+    path_registry::clear();
+    disk_cache_->clear();
+    signature_store::clear();
+    failure_store::clear();
 }
 
 void image_loader::start_loop()
+{
+    if (!workers_.empty() || abort_)
+    {
+        return;
+    }
+
+    workers_.reserve(static_cast<size_t>(worker_count_));
+    for (int i = 0; i < worker_count_; ++i)
+    {
+        QThread* worker = QThread::create([this]() { worker_loop(); });
+        worker->setObjectName(QString("thumbnail_worker_%1").arg(i));
+        workers_.push_back(worker);
+        worker->start(QThread::LowPriority);
+    }
+
+    background_worker_ = QThread::create([this]() { background_loop(); });
+    background_worker_->setObjectName("thumbnail_background");
+    background_worker_->start(QThread::IdlePriority);
+}
+
+void image_loader::worker_loop()
 {
     while (!abort_)
     {
         load_task current_task;
-        bool valid_task_found = false;
+        bool has_task = false;
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
 
+        submission_outcome outcome;
+        std::vector<load_task> upcoming;
+        qint64 budget = -1;
         {
             QMutexLocker locker(&mutex_);
-
-            while (task_queue_.isEmpty() && !abort_)
+            outcome = apply_submissions();
+            budget = std::exchange(pending_budget_, -1);
+            if (!task_queue_.empty())
             {
-                condition_.wait(&mutex_);
+                std::pop_heap(task_queue_.begin(), task_queue_.end(), task_order);
+                current_task = std::move(task_queue_.back());
+                task_queue_.pop_back();
+                in_flight_.insert(current_task.id, cancelled);
+                has_task = true;
             }
 
-            if (abort_)
+            upcoming.resize(std::min(task_queue_.size(), static_cast<size_t>(read_ahead_->depth())));
+            std::partial_sort_copy(task_queue_.begin(),
+                                   task_queue_.end(),
+                                   upcoming.begin(),
+                                   upcoming.end(),
+                                   [](const load_task& left, const load_task& right) { return task_order(right, left); });
+        }
+        deliver(outcome);
+        if (budget >= 0)
+        {
+            apply_budget(budget);
+        }
+        read_ahead_->prefetch(upcoming);
+
+        if (!has_task)
+        {
+            wakeups_.acquire();
+            continue;
+        }
+
+        if (!load_image_internal(current_task, *cancelled))
+        {
+            publish(current_task, QImage());
+        }
+        read_ahead_->discard({current_task.id});
+
+        QMutexLocker locker(&mutex_);
+        in_flight_.remove(current_task.id);
+    }
+}
+
+void image_loader::background_loop()
+{
+    remove_legacy_disk_cache();
+    signature_store::prune();
+    failure_store::prune();
+
+    QElapsedTimer progress_timer;
+    progress_timer.start();
+    while (!abort_)
+    {
+        if (disk_cache_->compaction_pending())
+        {
+            disk_cache_->compact();
+        }
+
+        load_task current_task;
+        bool has_task = false;
+        bool has_backlog = false;
+        bool foreground_idle = false;
+        quint64 generation = 0;
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
+
+        submission_outcome outcome;
+        {
+            QMutexLocker locker(&mutex_);
+            outcome = apply_submissions();
+            has_backlog = !background_queue_.empty();
+            foreground_idle = task_queue_.empty() && in_flight_.isEmpty();
+            if (has_backlog && background_share_ > 0 && foreground_idle)
             {
-                return;
+                current_task = std::move(background_queue_.front());
+                background_queue_.pop_front();
+                background_cancelled_ = cancelled;
+                generation = background_generation_;
+                has_task = true;
             }
+        }
+        deliver(outcome);
 
-            while (!task_queue_.isEmpty())
+        if (!has_task)
+        {
+            if (has_backlog)
+            {
+                background_wakeups_.tryAcquire(1, kBackgroundPollMs);
+            }
+            else if (!background_wakeups_.tryAcquire(1, kIdleMaintenanceMs) && foreground_idle)
             {
-                current_task = task_queue_.takeFirst();
+                disk_cache_->flush();
+            }
+            continue;
+        }
+
+        QElapsedTimer busy_timer;
+        busy_timer.start();
+        const bool finished = pregenerate(current_task, *cancelled);
+        const qint64 busy_ms = busy_timer.elapsed();
 
-                if (pending_cancels_.contains(current_task.path))
+        int done = 0;
+        int total = 0;
+        {
+            QMutexLocker locker(&mutex_);
+            background_cancelled_.reset();
+            if (generation == background_generation_)
+            {
+                if (finished)
                 {
-                    pending_cancels_.remove(current_task.path);
-                    continue;
+                    ++background_done_;
+                }
+                else
+                {
+                    background_queue_.push_front(std::move(current_task));
                 }
-
-                valid_task_found = true;
-                break;
             }
+            done = background_done_;
+            total = background_total_;
+        }
+        if (finished && (done == total || progress_timer.elapsed() >= kBackgroundProgressIntervalMs))
+        {
+            progress_timer.restart();
+            emit background_progress(done, total);
         }
 
-        if (valid_task_found)
+        const int share = background_share_.load();
+        if (share > 0 && share < 100)
         {
-            load_image_internal(current_task);
+            background_wakeups_.tryAcquire(1, static_cast<int>(std::min(busy_ms * (100 - share) / share, kMaxBackgroundPauseMs)));
         }
     }
 }
 
-void image_loader::load_image_internal(const load_task& current_task)
+bool image_loader::pregenerate(const load_task& task, const std::atomic<bool>& cancelled)
 {
-    const QString cache_key = memory_cache_key(current_task);
+    const QFileInfo file_info(task.path);
+    const quint64 disk_key = disk_cache_key(file_info, task.target_size.width());
+    if (disk_cache_->contains(disk_key) || known_failure(task.path, file_info))
+    {
+        return true;
+    }
 
+    QImage image;
+    const decode_status status = decode_thumbnail(task, file_info.suffix(), QByteArray(), cancelled, image);
+    if (cancelled)
     {
-        QMutexLocker locker(&mutex_);
-        if (cache_.contains(cache_key))
+        return false;
+    }
+    if (status != decode_status::decoded)
+    {
+        if (status == decode_status::undecodable)
         {
-            emit thumbnail_loaded(current_task.id, current_task.path, *cache_.object(cache_key), current_task.session_id);
-            return;
+            remember_failure(task.path, file_info);
         }
+        return true;
+    }
+    disk_cache_->insert(disk_key, image);
+    remember_signature(task.path, file_info, image);
+    return true;
+}
+
+QImage image_loader::load_preview(const load_task& task, const QString& suffix, const QByteArray& prefetched, const std::atomic<bool>& cancelled)
+{
+    const QSize preview_size = (task.target_size / kPreviewDivisor).expandedTo(QSize(1, 1));
+    image_source source(task.path, prefetched);
+    cancellable_device device(source.device(), &cancelled);
+    if (!source.is_open() || !device.open(QIODevice::ReadOnly))
+    {
+        return QImage();
+    }
+
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+    if (suffix.compare("jpg", Qt::CaseInsensitive) == 0 || suffix.compare("jpeg", Qt::CaseInsensitive) == 0)
+    {
+        QImage preview = jpeg_decoder::decode_thumbnail(source.bytes(), preview_size, &cancelled);
+        return source.truncated() ? QImage() : preview;
+    }
+#endif
+
+    QImageReader reader(&device, suffix.toLatin1());
+    reader.setAutoTransform(false);
+    if (!reader.supportsOption(QImageIOHandler::ScaledSize) || !reader.size().isValid())
+    {
+        return QImage();
+    }
+
+    const QImageIOHandler::Transformations transformation = reader.transformation();
+    reader.setQuality(0);
+    reader.setScaledSize(stored_size(preview_size, transformation));
+    QImage preview = reader.read();
+    if (source.truncated())
+    {
+        return QImage();
+    }
+    return pixel_kernels::transformed(pixel_kernels::to_premultiplied(std::move(preview)), transformation);
+}
+
+bool image_loader::load_image_internal(const load_task& current_task, const std::atomic<bool>& cancelled)
+{
+    const int bucket_width = current_task.target_size.width();
+    const quint64 cache_key = memory_cache_key(current_task.path_id, bucket_width);
+
+    QImage cached;
+    if (find_in_memory(cache_key, cached))
+    {
+        publish(current_task, cached);
+        return true;
+    }
+
+    const QFileInfo file_info(current_task.path);
+    const quint64 disk_key = disk_cache_key(file_info, bucket_width);
+    QImage image = disk_cache_->find(disk_key);
+    bool from_larger_bucket = false;
+    if (image.isNull() && bucket_width > 0)
+    {
+        image = load_from_larger_bucket(current_task, file_info);
+        from_larger_bucket = !image.isNull();
     }
 
-    QImage image = load_disk_cached_image(current_task);
     if (!image.isNull())
     {
-        if (image.format() != QImage::Format_ARGB32_Premultiplied)
+        image = pixel_kernels::to_premultiplied(std::move(image));
+        if (from_larger_bucket)
         {
-            image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            disk_cache_->insert(disk_key, image);
         }
-
-        QMutexLocker locker(&mutex_);
-        cache_.insert(cache_key, new QImage(image), image.sizeInBytes());
-        locker.unlock();
-        emit thumbnail_loaded(current_task.id, current_task.path, image, current_task.session_id);
-        return;
+        cache_.insert(cache_key, image);
+        remember_signature(current_task.path, file_info, image);
+        publish(current_task, image);
+        return true;
     }
 
-    QImageReader reader(current_task.path);
-    reader.setAutoTransform(true);
+    if (known_failure(current_task.path, file_info))
+    {
+        publish_broken(current_task);
+        return true;
+    }
 
-    const QSize source_size = reader.size();
-    const bool supports_scaled_size = reader.supportsOption(QImageIOHandler::ScaledSize);
+    const QString suffix = file_info.suffix();
+    const QByteArray prefetched = read_ahead_->take(current_task.id);
+    if (current_task.preview && !current_task.target_size.isEmpty())
+    {
+        const QImage preview = load_preview(current_task, suffix, prefetched, cancelled);
+        if (!preview.isNull())
+        {
+            if (cancelled)
+            {
+                return false;
+            }
+            publish(current_task, pixel_kernels::to_premultiplied(preview), true);
+            return true;
+        }
+    }
 
-    if (source_size.isValid())
+    const decode_status status = decode_thumbnail(current_task, suffix, prefetched, cancelled, image);
+    if (cancelled)
+    {
+        return false;
+    }
+    if (status != decode_status::decoded)
     {
-        const double estimated_mb =
-            (static_cast<double>(source_size.width()) * source_size.height() * 4.0) / (1024.0 * 1024.0);
-        const bool exceeds_allocation_limit = estimated_mb > kMaxImageAllocMB;
+        if (status == decode_status::undecodable)
+        {
+            remember_failure(current_task.path, file_info);
+        }
+        publish_broken(current_task);
+        return true;
+    }
 
-        if (supports_scaled_size && !current_task.target_size.isEmpty())
+    cache_.insert(cache_key, image);
+    disk_cache_->insert(disk_key, image);
+    remember_signature(current_task.path, file_info, image);
+    publish(current_task, image);
+    return true;
+}
+
+image_loader::decode_status image_loader::decode_thumbnail(
+    const load_task& task, const QString& suffix, const QByteArray& prefetched, const std::atomic<bool>& cancelled, QImage& image)
+{
+    image = QImage();
+
+#ifdef IMAGEVIEWER_HAVE_LIBJPEG
+    if (!task.target_size.isEmpty() &&
+        (suffix.compare("jpg", Qt::CaseInsensitive) == 0 || suffix.compare("jpeg", Qt::CaseInsensitive) == 0))
+    {
+        image_source source(task.path, prefetched);
+        if (source.is_open())
         {
-            QSize scaled_size = current_task.target_size;
-            if (exceeds_allocation_limit)
+            image = jpeg_decoder::decode_thumbnail(source.bytes(), task.target_size, &cancelled);
+            if (source.truncated())
             {
-                const double scale_factor = std::sqrt(kMaxImageAllocMB / estimated_mb);
-                const QSize safe_size = (source_size * scale_factor).expandedTo(QSize(1, 1));
-                scaled_size = scaled_size.boundedTo(safe_size).expandedTo(QSize(1, 1));
+                return decode_status::unavailable;
             }
-            reader.setScaledSize(scaled_size);
         }
-        else if (exceeds_allocation_limit)
+    }
+#endif
+
+#ifdef IMAGEVIEWER_HAVE_LIBPNG
+    if (image.isNull() && !task.target_size.isEmpty() && suffix.compare("png", Qt::CaseInsensitive) == 0)
+    {
+        image_source source(task.path, prefetched);
+        if (source.is_open())
         {
-            return;
+            image = png_decoder::decode_thumbnail(source.bytes(), task.target_size, &cancelled);
+            if (source.truncated())
+            {
+                return decode_status::unavailable;
+            }
         }
     }
+#endif
 
-    image = reader.read();
-    if (!image.isNull())
+    QImageIOHandler::Transformations transformation = QImageIOHandler::TransformationNone;
+    if (image.isNull() && !cancelled)
     {
-        if (!current_task.target_size.isEmpty() && image.size() != current_task.target_size)
+        image_source source(task.path, prefetched);
+        cancellable_device device(source.device(), &cancelled);
+        if (!source.is_open() || !device.open(QIODevice::ReadOnly))
         {
-            image = image.scaled(current_task.target_size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            return decode_status::unavailable;
         }
 
-        if (image.format() != QImage::Format_ARGB32_Premultiplied)
+        QImageReader reader(&device, suffix.toLatin1());
+        reader.setAutoTransform(false);
+        transformation = reader.transformation();
+
+        const QSize source_size = reader.size();
+        const bool supports_scaled_size = reader.supportsOption(QImageIOHandler::ScaledSize);
+
+        if (source_size.isValid())
         {
-            image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            const double estimated_mb =
+                (static_cast<double>(source_size.width()) * source_size.height() * 4.0) / (1024.0 * 1024.0);
+            const bool exceeds_allocation_limit = estimated_mb > kMaxImageAllocMB;
+
+            if (supports_scaled_size && !task.target_size.isEmpty())
+            {
+                QSize scaled_size = stored_size(task.target_size, transformation);
+                if (exceeds_allocation_limit)
+                {
+                    const double scale_factor = std::sqrt(kMaxImageAllocMB / estimated_mb);
+                    const QSize safe_size = (source_size * scale_factor).expandedTo(QSize(1, 1));
+                    scaled_size = scaled_size.boundedTo(safe_size).expandedTo(QSize(1, 1));
+                }
+                reader.setScaledSize(scaled_size);
+            }
+            else if (exceeds_allocation_limit)
+            {
+                return decode_status::unavailable;
+            }
         }
+
+        image = reader.read();
+        if (source.truncated())
         {
-            QMutexLocker locker(&mutex_);
-            auto cost = image.sizeInBytes();
-            cache_.insert(cache_key, new QImage(image), cost);
+            image = QImage();
+            return decode_status::unavailable;
         }
+        if (image.isNull() && !cancelled)
+        {
+            const QImageReader::ImageReaderError error = reader.error();
+            if (error == QImageReader::InvalidDataError || error == QImageReader::UnsupportedFormatError)
+            {
+                return decode_status::undecodable;
+            }
+            return decode_status::unavailable;
+        }
+    }
 
-        save_disk_cached_image(current_task, image);
+    if (image.isNull() || cancelled)
+    {
+        image = QImage();
+        return decode_status::unavailable;
+    }
 
-        emit thumbnail_loaded(current_task.id, current_task.path, image, current_task.session_id);
+    const QSize stored_target = stored_size(task.target_size, transformation);
+    if (!stored_target.isEmpty() && image.size() != stored_target)
+    {
+        image = area_scaler::scaled(image, stored_target);
     }
+    image = pixel_kernels::transformed(pixel_kernels::to_premultiplied(std::move(image)), transformation);
+    return image.isNull() ? decode_status::unavailable : decode_status::decoded;
 }
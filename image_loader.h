@@ -2,54 +2,147 @@
 #define IMAGE_VIEWER_IMAGE_LOADER_H
 
 #include <QObject>
+#include <QThread>
 #include <QImage>
-#include <QCache>
 #include <QList>
 #include <QSize>
 #include <QSet>
+#include <QHash>
 #include <QMutex>
-#include <QWaitCondition>
+#include <QSemaphore>
 #include <QString>
+#include <QFileInfo>
 #include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
 #include "common_types.h"
+#include "compressed_cache.h"
+#include "thumbnail_cache.h"
+#include "thumbnail_store.h"
+#include "read_ahead.h"
+#include "result_ring.h"
+#include "submission_queue.h"
 
 class image_loader : public QObject
 {
     Q_OBJECT
 
    public:
-    explicit image_loader(QObject* parent = nullptr);
+    explicit image_loader(int worker_count = 0, QObject* parent = nullptr);
     ~image_loader() override;
 
+    [[nodiscard]] bool take_result(thumbnail_result& result);
+    [[nodiscard]] std::vector<thumbnail_cache::shard_stats> memory_cache_stats() const;
+    [[nodiscard]] compressed_cache::cache_stats compressed_cache_stats() const;
+    void set_memory_cache_budget(qint64 bytes);
+    void set_read_ahead_depth(int depth);
+    void set_background_cpu_share(int percent);
+
    public slots:
     void start_loop();
     void stop();
     void request_thumbnails(const QList<load_task>& tasks);
-    void cancel_thumbnails(const QList<QString>& paths);
+    void request_background(const QList<load_task>& tasks);
+    void update_priorities(const QList<task_priority>& priorities);
+    void cancel_thumbnails(const QList<quint64>& ids);
     void clear_all();
     void clear_cache();
 
    signals:
-    void thumbnail_loaded(quint64 id, QString path, QImage image, int session_id);
-    void tasks_dropped(const QList<QString>& paths);
+    void results_ready();
+    void background_progress(int done, int total);
 
    private:
-    [[nodiscard]] QString memory_cache_key(const load_task& task) const;
-    [[nodiscard]] QString disk_cache_path(const load_task& task) const;
-    [[nodiscard]] QImage load_disk_cached_image(const load_task& task) const;
-    void save_disk_cached_image(const load_task& task, const QImage& image);
-    void cleanup_disk_cache();
-    void load_image_internal(const load_task& task);
+    struct submission
+    {
+        enum class kind
+        {
+            load,
+            background,
+            reprioritize,
+            cancel,
+            clear,
+            budget
+        };
+
+        kind type = kind::load;
+        QList<load_task> tasks;
+        QList<task_priority> priorities;
+        QList<quint64> ids;
+        qint64 bytes = 0;
+    };
+
+    struct submission_outcome
+    {
+        bool has_results = false;
+    };
+
+    // Only undecodable files are remembered as failures; unavailable covers I/O errors, the allocation guard and
+    // cancellation, all of which may succeed on a later attempt.
+    enum class decode_status
+    {
+        decoded,
+        unavailable,
+        undecodable
+    };
+
+    void submit(submission&& request);
+    [[nodiscard]] submission_outcome apply_submissions();
+    void deliver(const submission_outcome& outcome);
+    void apply_load(const QList<load_task>& tasks, submission_outcome& outcome);
+    void apply_background(const QList<load_task>& tasks);
+    void apply_priorities(const QList<task_priority>& priorities);
+    void apply_cancel(const QList<quint64>& ids);
+    void apply_clear();
+    void apply_budget(qint64 bytes);
+    void worker_loop();
+    void background_loop();
+    [[nodiscard]] bool pregenerate(const load_task& task, const std::atomic<bool>& cancelled);
+    [[nodiscard]] bool find_in_memory(quint64 key, QImage& image);
+    [[nodiscard]] quint64 disk_cache_key(const QFileInfo& file_info, int bucket_width) const;
+    [[nodiscard]] QImage load_from_larger_bucket(const load_task& task, const QFileInfo& file_info);
+    [[nodiscard]] bool needs_source(const load_task& task) const;
+    [[nodiscard]] QImage load_preview(const load_task& task,
+                                      const QString& suffix,
+                                      const QByteArray& prefetched,
+                                      const std::atomic<bool>& cancelled);
+    [[nodiscard]] decode_status decode_thumbnail(const load_task& task,
+                                                 const QString& suffix,
+                                                 const QByteArray& prefetched,
+                                                 const std::atomic<bool>& cancelled,
+                                                 QImage& image);
+    [[nodiscard]] bool load_image_internal(const load_task& task, const std::atomic<bool>& cancelled);
+    void publish(const load_task& task, const QImage& image, bool preview = false);
+    void publish_broken(const load_task& task);
+    void push_result(thumbnail_result&& result);
+    void notify_results();
 
    private:
-    QCache<QString, QImage> cache_;
-    QList<load_task> task_queue_;
-    QSet<QString> pending_cancels_;
-    QString disk_cache_dir_;
+    thumbnail_cache cache_;
+    compressed_cache compressed_cache_;
+    std::vector<load_task> task_queue_;
+    QHash<quint64, std::shared_ptr<std::atomic<bool>>> in_flight_;
+    std::unique_ptr<thumbnail_store> disk_cache_;
+    std::unique_ptr<read_ahead> read_ahead_;
+    int worker_count_ = 0;
+    std::vector<QThread*> workers_;
+    QThread* background_worker_ = nullptr;
+    std::deque<load_task> background_queue_;
+    std::shared_ptr<std::atomic<bool>> background_cancelled_;
+    quint64 background_generation_ = 0;
+    int background_done_ = 0;
+    int background_total_ = 0;
+    std::atomic<int> background_share_;
+    qint64 pending_budget_ = -1;
 
     QMutex mutex_;
-    QWaitCondition condition_;
+    QSemaphore wakeups_;
+    QSemaphore background_wakeups_;
+    submission_queue<submission> submissions_;
     std::atomic<bool> abort_;
+    result_ring<thumbnail_result> results_;
+    std::atomic<bool> results_signalled_{false};
 };
 
 #endif
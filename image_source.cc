@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <csignal>
+#include "image_source.h"
+
+#ifdef Q_OS_UNIX
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Large files are decoded straight from a read-only mapping. If another process truncates the file while it is mapped,
+// touching a page past the new end raises SIGBUS instead of returning a short read. Files cannot be locked against
+// truncation, so on Unix a SIGBUS handler covers the mappings: a fault inside one that the faulting thread is decoding
+// from replaces the rest of the mapping with zero pages and marks the source truncated, and the caller throws the
+// result away. Faults anywhere else go to the previously installed handler.
+struct image_source::mapping_guard
+{
+    const uchar* begin = nullptr;
+    qint64 size = 0;
+    volatile sig_atomic_t truncated = 0;
+    mapping_guard* previous = nullptr;
+};
+
+namespace
+{
+constexpr qint64 kMinMappedBytes = 64 * 1024;
+constexpr qint64 kWillNeedBytes = 256 * 1024;
+
+#ifdef Q_OS_UNIX
+// SIGBUS is delivered to the faulting thread, so each thread only has to know about its own live mappings.
+thread_local image_source::mapping_guard* t_guards = nullptr;
+struct sigaction g_previous_sigbus;
+uintptr_t g_page_mask = 0;
+
+void forward_sigbus(int signal, siginfo_t* info, void* context)
+{
+    if ((g_previous_sigbus.sa_flags & SA_SIGINFO) != 0 && g_previous_sigbus.sa_sigaction != nullptr)
+    {
+        g_previous_sigbus.sa_sigaction(signal, info, context);
+    }
+    else if (g_previous_sigbus.sa_handler != SIG_DFL && g_previous_sigbus.sa_handler != SIG_IGN)
+    {
+        g_previous_sigbus.sa_handler(signal);
+    }
+    else
+    {
+        // Returning re-executes the faulting access, which now gets the default action.
+        ::sigaction(SIGBUS, &g_previous_sigbus, nullptr);
+    }
+}
+
+void on_sigbus(int signal, siginfo_t* info, void* context)
+{
+    const auto* address = static_cast<const uchar*>(info->si_addr);
+    for (image_source::mapping_guard* guard = t_guards; guard != nullptr; guard = guard->previous)
+    {
+        if (address < guard->begin || address >= guard->begin + guard->size)
+        {
+            continue;
+        }
+
+        auto* from = reinterpret_cast<uchar*>(reinterpret_cast<uintptr_t>(address) & g_page_mask);
+        const auto length = static_cast<size_t>(guard->begin + guard->size - from);
+        if (::mmap(from, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+        {
+            break;
+        }
+        guard->truncated = 1;
+        return;
+    }
+    forward_sigbus(signal, info, context);
+}
+
+void install_sigbus_handler()
+{
+    static std::once_flag installed;
+    std::call_once(installed,
+                   []()
+                   {
+                       g_page_mask = ~(static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE)) - 1);
+                       struct sigaction action = {};
+                       action.sa_sigaction = on_sigbus;
+                       action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+                       sigemptyset(&action.sa_mask);
+                       ::sigaction(SIGBUS, &action, &g_previous_sigbus);
+                   });
+}
+#endif
+}
+
+image_source::image_source(const QString& path, const QByteArray& prefetched) : file_(path)
+{
+    if (!prefetched.isEmpty())
+    {
+        data_ = prefetched;
+    }
+    else if (file_.open(QIODevice::ReadOnly))
+    {
+        const qint64 size = file_.size();
+        if (size >= kMinMappedBytes && !file_.isSequential())
+        {
+#ifdef Q_OS_UNIX
+            install_sigbus_handler();
+#endif
+            map_ = file_.map(0, size);
+        }
+        if (map_ == nullptr)
+        {
+            device_ = &file_;
+            return;
+        }
+
+#ifdef Q_OS_UNIX
+        guard_ = std::make_unique<mapping_guard>();
+        guard_->begin = map_;
+        guard_->size = size;
+        guard_->previous = t_guards;
+        t_guards = guard_.get();
+
+        // Decoders read front to back; only the start is prefetched so a huge file does not flood the page cache.
+        ::madvise(map_, static_cast<size_t>(size), MADV_SEQUENTIAL);
+        ::madvise(map_, static_cast<size_t>(std::min(size, kWillNeedBytes)), MADV_WILLNEED);
+#endif
+        data_ = QByteArray::fromRawData(reinterpret_cast<const char*>(map_), static_cast<qsizetype>(size));
+    }
+    else
+    {
+        return;
+    }
+
+    buffer_.setData(data_);
+    if (buffer_.open(QIODevice::ReadOnly))
+    {
+        device_ = &buffer_;
+    }
+}
+
+image_source::~image_source()
+{
+    buffer_.close();
+    buffer_.setData(QByteArray());
+    data_ = QByteArray();
+    if (map_ != nullptr)
+    {
+#ifdef Q_OS_UNIX
+        for (mapping_guard** link = &t_guards; *link != nullptr; link = &(*link)->previous)
+        {
+            if (*link == guard_.get())
+            {
+                *link = guard_->previous;
+                break;
+            }
+        }
+#endif
+        file_.unmap(map_);
+    }
+}
+
+bool image_source::truncated() const { return guard_ != nullptr && guard_->truncated != 0; }
+
+QByteArray image_source::bytes()
+{
+    if (device_ == &file_)
+    {
+        // Only files below kMinMappedBytes, or ones that could not be mapped, take this path, so the copy stays small
+        // in the common case.
+        file_.seek(0);
+        return file_.readAll();
+    }
+    return data_;
+}
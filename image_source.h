@@ -0,0 +1,39 @@
+#ifndef IMAGE_VIEWER_IMAGE_SOURCE_H
+#define IMAGE_VIEWER_IMAGE_SOURCE_H
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <memory>
+
+// Reads a file for decoding, from a memory mapping when it is large enough. Must be used and destroyed on the thread
+// that created it.
+class image_source
+{
+   public:
+    struct mapping_guard;
+
+    explicit image_source(const QString& path, const QByteArray& prefetched = QByteArray());
+    ~image_source();
+
+    image_source(const image_source&) = delete;
+    image_source& operator=(const image_source&) = delete;
+
+    [[nodiscard]] bool is_open() const { return device_ != nullptr; }
+    [[nodiscard]] bool is_mapped() const { return map_ != nullptr; }
+    [[nodiscard]] QIODevice* device() const { return device_; }
+    [[nodiscard]] QByteArray bytes();
+    // The file shrank while it was mapped and the missing tail read as zeros; anything decoded from it is garbage.
+    [[nodiscard]] bool truncated() const;
+
+   private:
+    QFile file_;
+    uchar* map_ = nullptr;
+    QByteArray data_;
+    QBuffer buffer_;
+    QIODevice* device_ = nullptr;
+    std::unique_ptr<mapping_guard> guard_;
+};
+
+#endif
@@ -31,11 +31,31 @@
 #include <QWindow>
 #include "common_types.h"
 #include "image_viewer_window.h"
+#include "image_source.h"
+#include "pixel_kernels.h"
 
 namespace
 {
 constexpr qint64 kAnimatedCacheAllMaxBytes = 20LL * 1024 * 1024;
 
+// Formats the raster paint engine blends directly; anything else is converted once off the GUI thread.
+bool is_fast_paint_format(QImage::Format format)
+{
+    switch (format)
+    {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+        case QImage::Format_RGBX8888:
+        case QImage::Format_RGBA8888_Premultiplied:
+        case QImage::Format_RGB888:
+        case QImage::Format_RGB16:
+        case QImage::Format_Grayscale8:
+            return true;
+        default:
+            return false;
+    }
+}
+
 bool is_animated_image(const QString& path)
 {
     QImageReader reader(path);
@@ -44,8 +64,15 @@ bool is_animated_image(const QString& path)
 
 std::pair<QImage, QString> load_image_file(const QString& path)
 {
-    QImageReader reader(path);
-    reader.setAutoTransform(true);
+    image_source source(path);
+    if (!source.is_open())
+    {
+        return {QImage(), QString("无法读取图片数据：%1").arg(QFileInfo(path).fileName())};
+    }
+
+    QImageReader reader(source.device(), QFileInfo(path).suffix().toLatin1());
+    reader.setAutoTransform(false);
+    const QImageIOHandler::Transformations transformation = reader.transformation();
 
     const QSize img_size = reader.size();
     const bool supports_scaled_size = reader.supportsOption(QImageIOHandler::ScaledSize);
@@ -78,6 +105,10 @@ std::pair<QImage, QString> load_image_file(const QString& path)
     }
 
     QImage image = reader.read();
+    if (source.truncated())
+    {
+        return {QImage(), QString("图片在读取过程中被截断：%1").arg(QFileInfo(path).fileName())};
+    }
 
     if (image.isNull())
     {
@@ -89,7 +120,11 @@ std::pair<QImage, QString> load_image_file(const QString& path)
         return {QImage(), QString("无法读取图片数据：%1").arg(err)};
     }
 
-    return {image, QString()};
+    if (!is_fast_paint_format(image.format()))
+    {
+        image = pixel_kernels::to_premultiplied(std::move(image));
+    }
+    return {pixel_kernels::transformed(std::move(image), transformation), QString()};
 }
 }
 
@@ -101,6 +136,8 @@ image_viewer_window::image_viewer_window(QWidget* parent)
     load_settings();
 }
 
+void image_viewer_window::set_cache_budget(qint64 bytes) { image_cache_.setMaxCost(bytes); }
+
 image_viewer_window::~image_viewer_window()
 {
     clear_movie();
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <jpeglib.h>
+#include "jpeg_decoder.h"
+#include "pixel_kernels.h"
+
+namespace
+{
+struct exif_info
+{
+    int orientation = 1;
+    qsizetype thumbnail_offset = 0;
+    qsizetype thumbnail_size = 0;
+};
+
+struct error_manager
+{
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+};
+
+void on_jpeg_error(j_common_ptr cinfo)
+{
+    auto* err = reinterpret_cast<error_manager*>(cinfo->err);
+    std::longjmp(err->jump, 1);
+}
+
+void on_jpeg_message(j_common_ptr /*cinfo*/) {}
+
+class tiff_reader
+{
+   public:
+    tiff_reader(const uchar* data, qsizetype size) : data_(data), size_(size)
+    {
+        if (size_ >= 8)
+        {
+            little_endian_ = data_[0] == 'I' && data_[1] == 'I';
+            valid_ = (little_endian_ || (data_[0] == 'M' && data_[1] == 'M')) && read16(2) == 42;
+        }
+    }
+
+    [[nodiscard]] bool valid() const { return valid_; }
+
+    [[nodiscard]] quint32 read16(qsizetype offset) const
+    {
+        if (offset < 0 || offset + 2 > size_)
+        {
+            return 0;
+        }
+        const uchar* p = data_ + offset;
+        return little_endian_ ? (p[0] | (p[1] << 8)) : ((p[0] << 8) | p[1]);
+    }
+
+    [[nodiscard]] quint32 read32(qsizetype offset) const
+    {
+        if (offset < 0 || offset + 4 > size_)
+        {
+            return 0;
+        }
+        const uchar* p = data_ + offset;
+        return little_endian_ ? (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<quint32>(p[3]) << 24))
+                              : ((static_cast<quint32>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+    }
+
+   private:
+    const uchar* data_;
+    qsizetype size_;
+    bool little_endian_ = true;
+    bool valid_ = false;
+};
+
+void parse_tiff(const uchar* tiff, qsizetype tiff_size, qsizetype tiff_base, exif_info& info)
+{
+    constexpr quint32 kTagOrientation = 0x0112;
+    constexpr quint32 kTagThumbnailOffset = 0x0201;
+    constexpr quint32 kTagThumbnailLength = 0x0202;
+    constexpr qsizetype kEntryBytes = 12;
+
+    const tiff_reader reader(tiff, tiff_size);
+    if (!reader.valid())
+    {
+        return;
+    }
+
+    const qsizetype ifd0 = reader.read32(4);
+    const qsizetype ifd0_count = reader.read16(ifd0);
+    for (qsizetype i = 0; i < ifd0_count; ++i)
+    {
+        const qsizetype entry = ifd0 + 2 + (i * kEntryBytes);
+        if (reader.read16(entry) == kTagOrientation)
+        {
+            const int orientation = static_cast<int>(reader.read16(entry + 8));
+            info.orientation = orientation >= 1 && orientation <= 8 ? orientation : 1;
+        }
+    }
+
+    const qsizetype ifd1 = reader.read32(ifd0 + 2 + (ifd0_count * kEntryBytes));
+    if (ifd1 <= 0 || ifd1 >= tiff_size)
+    {
+        return;
+    }
+
+    qsizetype thumbnail_offset = 0;
+    qsizetype thumbnail_size = 0;
+    const qsizetype ifd1_count = reader.read16(ifd1);
+    for (qsizetype i = 0; i < ifd1_count; ++i)
+    {
+        const qsizetype entry = ifd1 + 2 + (i * kEntryBytes);
+        const quint32 tag = reader.read16(entry);
+        if (tag == kTagThumbnailOffset)
+        {
+            thumbnail_offset = reader.read32(entry + 8);
+        }
+        else if (tag == kTagThumbnailLength)
+        {
+            thumbnail_size = reader.read32(entry + 8);
+        }
+    }
+
+    if (thumbnail_offset > 0 && thumbnail_size > 0 && thumbnail_offset + thumbnail_size <= tiff_size)
+    {
+        info.thumbnail_offset = tiff_base + thumbnail_offset;
+        info.thumbnail_size = thumbnail_size;
+    }
+}
+
+exif_info parse_exif(const uchar* data, qsizetype size)
+{
+    exif_info info;
+    qsizetype pos = 2;
+    while (pos + 4 <= size && data[pos] == 0xFF)
+    {
+        const uchar marker = data[pos + 1];
+        if (marker == 0xFF)
+        {
+            ++pos;
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9)
+        {
+            break;
+        }
+
+        const qsizetype length = (data[pos + 2] << 8) | data[pos + 3];
+        if (length < 2 || pos + 2 + length > size)
+        {
+            break;
+        }
+        if (marker == 0xE1 && length >= 8 && std::memcmp(data + pos + 4, "Exif\0\0", 6) == 0)
+        {
+            parse_tiff(data + pos + 10, length - 8, pos + 10, info);
+            break;
+        }
+        pos += 2 + length;
+    }
+    return info;
+}
+
+struct jpeg_stream
+{
+    jpeg_decompress_struct cinfo{};
+    error_manager jerr{};
+    bool created = false;
+
+    jpeg_stream() = default;
+    jpeg_stream(const jpeg_stream&) = delete;
+    jpeg_stream& operator=(const jpeg_stream&) = delete;
+    ~jpeg_stream()
+    {
+        if (created)
+        {
+            jpeg_destroy_decompress(&cinfo);
+        }
+    }
+};
+
+bool read_header(jpeg_stream& stream, const uchar* data, qsizetype size)
+{
+    jpeg_decompress_struct& cinfo = stream.cinfo;
+    cinfo.err = jpeg_std_error(&stream.jerr.pub);
+    stream.jerr.pub.error_exit = on_jpeg_error;
+    stream.jerr.pub.output_message = on_jpeg_message;
+
+    if (setjmp(stream.jerr.jump) != 0)
+    {
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    stream.created = true;
+    jpeg_mem_src(&cinfo, const_cast<uchar*>(data), static_cast<unsigned long>(size));
+    jpeg_read_header(&cinfo, TRUE);
+    return true;
+}
+
+bool decode_scaled(jpeg_stream& stream, const QSize& min_size, bool allow_smaller, const std::atomic<bool>* cancelled, QImage& out)
+{
+    jpeg_decompress_struct& cinfo = stream.cinfo;
+    if (setjmp(stream.jerr.jump) != 0)
+    {
+        return false;
+    }
+
+    if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK)
+    {
+        return false;
+    }
+
+    const auto min_width = static_cast<JDIMENSION>(std::max(1, min_size.width()));
+    const auto min_height = static_cast<JDIMENSION>(std::max(1, min_size.height()));
+    if (!allow_smaller && (cinfo.image_width < min_width || cinfo.image_height < min_height))
+    {
+        return true;
+    }
+
+    unsigned int denom = 8;
+    while (denom > 1 && ((cinfo.image_width + denom - 1) / denom < min_width || (cinfo.image_height + denom - 1) / denom < min_height))
+    {
+        denom /= 2;
+    }
+
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+#ifdef JCS_EXTENSIONS
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    cinfo.out_color_space = JCS_EXT_BGRX;
+#else
+    cinfo.out_color_space = JCS_EXT_XRGB;
+#endif
+    const QImage::Format format = QImage::Format_RGB32;
+#else
+    cinfo.out_color_space = JCS_RGB;
+    const QImage::Format format = QImage::Format_RGB888;
+#endif
+
+    jpeg_start_decompress(&cinfo);
+    out = QImage(static_cast<int>(cinfo.output_width), static_cast<int>(cinfo.output_height), format);
+    if (out.isNull())
+    {
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        if (cancelled != nullptr && cancelled->load(std::memory_order_relaxed))
+        {
+            jpeg_abort_decompress(&cinfo);
+            return false;
+        }
+        JSAMPROW row = out.scanLine(static_cast<int>(cinfo.output_scanline));
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    return true;
+}
+
+bool matches_aspect(const QSize& left, const QSize& right)
+{
+    if (left.isEmpty() || right.isEmpty())
+    {
+        return false;
+    }
+    const double left_ratio = static_cast<double>(left.width()) / left.height();
+    const double right_ratio = static_cast<double>(right.width()) / right.height();
+    return std::abs(left_ratio - right_ratio) <= 0.02 * right_ratio;
+}
+}
+
+namespace jpeg_decoder
+{
+bool is_jpeg(const QByteArray& data)
+{
+    return data.size() > 4 && static_cast<uchar>(data[0]) == 0xFF && static_cast<uchar>(data[1]) == 0xD8 &&
+           static_cast<uchar>(data[2]) == 0xFF;
+}
+
+QImage decode_thumbnail(const QByteArray& data, const QSize& target_size, const std::atomic<bool>* cancelled)
+{
+    if (!is_jpeg(data) || target_size.isEmpty())
+    {
+        return QImage();
+    }
+
+    const auto* bytes = reinterpret_cast<const uchar*>(data.constData());
+    const qsizetype size = data.size();
+    const exif_info exif = parse_exif(bytes, size);
+    const bool swaps_axes = exif.orientation >= 5;
+    const QSize stored_target = swaps_axes ? target_size.transposed() : target_size;
+
+    jpeg_stream stream;
+    if (!read_header(stream, bytes, size))
+    {
+        return QImage();
+    }
+    const QSize stored_size(static_cast<int>(stream.cinfo.image_width), static_cast<int>(stream.cinfo.image_height));
+
+    QImage image;
+    if (exif.thumbnail_size > 0)
+    {
+        jpeg_stream preview_stream;
+        QImage preview;
+        if (read_header(preview_stream, bytes + exif.thumbnail_offset, exif.thumbnail_size) &&
+            decode_scaled(preview_stream, stored_target, false, cancelled, preview) && matches_aspect(preview.size(), stored_size))
+        {
+            image = preview;
+        }
+    }
+
+    if (image.isNull() && !decode_scaled(stream, stored_target, true, cancelled, image))
+    {
+        return QImage();
+    }
+    if (image.isNull())
+    {
+        return QImage();
+    }
+
+    return pixel_kernels::transformed(std::move(image), pixel_kernels::exif_transformation(exif.orientation));
+}
+}
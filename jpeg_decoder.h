@@ -0,0 +1,15 @@
+#ifndef IMAGE_VIEWER_JPEG_DECODER_H
+#define IMAGE_VIEWER_JPEG_DECODER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QSize>
+#include <atomic>
+
+namespace jpeg_decoder
+{
+[[nodiscard]] bool is_jpeg(const QByteArray& data);
+[[nodiscard]] QImage decode_thumbnail(const QByteArray& data, const QSize& target_size, const std::atomic<bool>* cancelled = nullptr);
+}
+
+#endif
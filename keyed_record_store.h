@@ -0,0 +1,225 @@
+#ifndef IMAGE_VIEWER_KEYED_RECORD_STORE_H
+#define IMAGE_VIEWER_KEYED_RECORD_STORE_H
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QString>
+#include <type_traits>
+#include <utility>
+
+// Per-file records keyed by path and validated against the file's modification time and size, loaded lazily from and
+// flushed to a single file in the cache directory. Payload is streamed with QDataStream operators; an empty payload
+// type stores only the key. Lookups never drop records; prune() clears out those for deleted files.
+template <typename Payload>
+class keyed_record_store
+{
+   public:
+    keyed_record_store(quint32 magic, quint32 version, QString file_name)
+        : magic_(magic), version_(version), file_name_(std::move(file_name))
+    {
+    }
+
+    keyed_record_store(const keyed_record_store&) = delete;
+    keyed_record_store& operator=(const keyed_record_store&) = delete;
+
+    [[nodiscard]] bool contains(const QString& path, qint64 modified_time, qint64 file_size)
+    {
+        QMutexLocker locker(&mutex_);
+        return find_current(path, modified_time, file_size) != nullptr;
+    }
+
+    [[nodiscard]] bool find(const QString& path, qint64 modified_time, qint64 file_size, Payload& payload)
+    {
+        QMutexLocker locker(&mutex_);
+        const record* r = find_current(path, modified_time, file_size);
+        if (r == nullptr)
+        {
+            return false;
+        }
+        payload = r->payload;
+        return true;
+    }
+
+    void insert(const QString& path, qint64 modified_time, qint64 file_size, const Payload& payload = Payload())
+    {
+        QMutexLocker locker(&mutex_);
+        ensure_loaded();
+        records_.insert(path, {modified_time, file_size, payload});
+        dirty_ = true;
+    }
+
+    // Drops records whose file no longer exists, plus any the caller reports as expired. The existence checks run
+    // without the lock so lookups are not stalled behind a large store.
+    template <typename Expired>
+    void prune(Expired expired)
+    {
+        QList<QString> paths;
+        {
+            QMutexLocker locker(&mutex_);
+            ensure_loaded();
+            paths = records_.keys();
+        }
+
+        QList<QString> missing;
+        for (const QString& path : std::as_const(paths))
+        {
+            if (!QFileInfo::exists(path))
+            {
+                missing.append(path);
+            }
+        }
+
+        QMutexLocker locker(&mutex_);
+        for (const QString& path : std::as_const(missing))
+        {
+            if (records_.remove(path))
+            {
+                dirty_ = true;
+            }
+        }
+        for (auto it = records_.begin(); it != records_.end();)
+        {
+            if (expired(it->payload))
+            {
+                it = records_.erase(it);
+                dirty_ = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void prune()
+    {
+        prune([](const Payload&) { return false; });
+    }
+
+    void clear()
+    {
+        QMutexLocker locker(&mutex_);
+        records_.clear();
+        loaded_ = true;
+        dirty_ = false;
+        QFile::remove(store_path());
+    }
+
+    void flush()
+    {
+        QMutexLocker locker(&mutex_);
+        if (!dirty_)
+        {
+            return;
+        }
+
+        const QString path = store_path();
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            return;
+        }
+
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << magic_ << version_ << static_cast<quint32>(records_.size());
+        for (auto it = records_.constBegin(); it != records_.constEnd(); ++it)
+        {
+            stream << it.key() << it->modified_time << it->file_size;
+            if constexpr (!std::is_empty_v<Payload>)
+            {
+                stream << it->payload;
+            }
+        }
+
+        if (stream.status() == QDataStream::Ok && file.commit())
+        {
+            dirty_ = false;
+        }
+    }
+
+   private:
+    struct record
+    {
+        qint64 modified_time = 0;
+        qint64 file_size = 0;
+        Payload payload{};
+    };
+
+    [[nodiscard]] QString store_path() const { return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + file_name_; }
+
+    [[nodiscard]] const record* find_current(const QString& path, qint64 modified_time, qint64 file_size)
+    {
+        ensure_loaded();
+        auto it = records_.constFind(path);
+        if (it == records_.constEnd() || it->modified_time != modified_time || it->file_size != file_size)
+        {
+            return nullptr;
+        }
+        return &*it;
+    }
+
+    void ensure_loaded()
+    {
+        if (loaded_)
+        {
+            return;
+        }
+        loaded_ = true;
+
+        QFile file(store_path());
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return;
+        }
+
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_6_0);
+
+        quint32 magic = 0;
+        quint32 version = 0;
+        quint32 count = 0;
+        stream >> magic >> version >> count;
+        if (stream.status() != QDataStream::Ok || magic != magic_ || version != version_)
+        {
+            return;
+        }
+
+        records_.reserve(static_cast<qsizetype>(count));
+        for (quint32 i = 0; i < count; ++i)
+        {
+            QString path;
+            record r;
+            stream >> path >> r.modified_time >> r.file_size;
+            if constexpr (!std::is_empty_v<Payload>)
+            {
+                stream >> r.payload;
+            }
+            if (stream.status() != QDataStream::Ok)
+            {
+                records_.clear();
+                return;
+            }
+            records_.insert(path, r);
+        }
+    }
+
+   private:
+    const quint32 magic_;
+    const quint32 version_;
+    const QString file_name_;
+    QMutex mutex_;
+    QHash<QString, record> records_;
+    bool loaded_ = false;
+    bool dirty_ = false;
+};
+
+#endif
@@ -21,7 +21,9 @@
 #include <QProcess>
 #include <QStandardPaths>
 #include <QToolBar>
+#include <QScreen>
 #include <vector>
+#include <algorithm>
 
 #include "main_window.h"
 #include "image_loader.h"
@@ -31,6 +33,15 @@
 #include "waterfall_item.h"
 #include "image_viewer_window.h"
 #include "file_scanner.h"
+#include "memory_budget.h"
+
+namespace
+{
+constexpr int kDrainBudgetMs = 4;
+constexpr int kDrainChunk = 16;
+constexpr int kFallbackFrameMs = 16;
+constexpr int kCacheStatsIntervalMs = 1000;
+}
 
 main_window::main_window(QWidget* parent) : QMainWindow(parent)
 {
@@ -233,12 +244,31 @@ void main_window::setup_ui()
 
 void main_window::setup_worker()
 {
+    QSettings settings("gyl30", "ImageViewer");
+    const int worker_count = settings.value("image_loader/worker_count", 0).toInt();
+    scene_->set_two_pass(settings.value("image_loader/two_pass", true).toBool());
+
+    memory_budget_ = new memory_budget(this);
     worker_thread_ = new QThread(this);
-    image_loader_ = new image_loader();
+    image_loader_ = new image_loader(worker_count);
+    image_loader_->set_memory_cache_budget(memory_budget_->thumbnail_cache_bytes());
+    image_loader_->set_read_ahead_depth(settings.value("image_loader/read_ahead_depth", 8).toInt());
+    image_loader_->set_background_cpu_share(settings.value("image_loader/background_cpu_share", 25).toInt());
     image_loader_->moveToThread(worker_thread_);
     connect(worker_thread_, &QThread::finished, image_loader_, &QObject::deleteLater);
     connect(worker_thread_, &QThread::started, image_loader_, &image_loader::start_loop);
     worker_thread_->start();
+
+    const qreal refresh_rate = screen() != nullptr ? screen()->refreshRate() : 0.0;
+    drain_timer_ = new QTimer(this);
+    drain_timer_->setTimerType(Qt::PreciseTimer);
+    drain_timer_->setInterval(refresh_rate > 0.0 ? std::max(1, qRound(1000.0 / refresh_rate)) : kFallbackFrameMs);
+    connect(drain_timer_, &QTimer::timeout, this, &main_window::drain_results);
+
+    cache_stats_timer_ = new QTimer(this);
+    cache_stats_timer_->setInterval(kCacheStatsIntervalMs);
+    connect(cache_stats_timer_, &QTimer::timeout, this, &main_window::refresh_cache_stats);
+    cache_stats_timer_->start();
 }
 
 void main_window::setup_scanner()
@@ -260,10 +290,54 @@ void main_window::setup_scanner()
 void main_window::setup_connections()
 {
     connect(scene_, &waterfall_scene::request_load_batch, image_loader_, &image_loader::request_thumbnails, Qt::DirectConnection);
+    connect(scene_,
+            &waterfall_scene::request_update_priorities,
+            image_loader_,
+            &image_loader::update_priorities,
+            Qt::DirectConnection);
     connect(scene_, &waterfall_scene::request_cancel_batch, image_loader_, &image_loader::cancel_thumbnails, Qt::DirectConnection);
     connect(scene_, &waterfall_scene::request_cancel_all, image_loader_, &image_loader::clear_all, Qt::DirectConnection);
-    connect(image_loader_, &image_loader::thumbnail_loaded, scene_, &waterfall_scene::on_image_loaded);
-    connect(image_loader_, &image_loader::tasks_dropped, scene_, &waterfall_scene::on_tasks_dropped);
+    connect(scene_,
+            &waterfall_scene::request_background_batch,
+            image_loader_,
+            &image_loader::request_background,
+            Qt::DirectConnection);
+    connect(
+        image_loader_,
+        &image_loader::background_progress,
+        this,
+        [this](int done, int total)
+        {
+            background_done_ = done;
+            background_total_ = total;
+            update_status_bar();
+        },
+        Qt::QueuedConnection);
+    connect(
+        image_loader_,
+        &image_loader::results_ready,
+        this,
+        [this]()
+        {
+            if (!drain_timer_->isActive())
+            {
+                drain_results();
+                drain_timer_->start();
+            }
+        },
+        Qt::QueuedConnection);
+    connect(memory_budget_,
+            &memory_budget::budgets_changed,
+            this,
+            [this](qint64 thumbnail_cache_bytes, qint64 viewer_cache_bytes)
+            {
+                image_loader_->set_memory_cache_budget(thumbnail_cache_bytes);
+                if (viewer_window_ != nullptr)
+                {
+                    viewer_window_->set_cache_budget(viewer_cache_bytes);
+                }
+            });
+    memory_budget_->start();
 
     connect(view_, &waterfall_view::view_resized, this, [this](int width) { scene_->layout_models(width); });
 
@@ -281,7 +355,6 @@ void main_window::setup_connections()
                 statusBar()->showMessage("已清理缩略图缓存", 3000);
             });
     connect(scene_, &QGraphicsScene::selectionChanged, this, &main_window::on_selection_changed);
-    connect(image_loader_, &image_loader::thumbnail_loaded, this, &main_window::on_image_loaded_stat);
 }
 
 void main_window::load_settings()
@@ -421,6 +494,8 @@ void main_window::open_path(const QString& path, bool add_to_recent)
     scene_->clear_items();
     total_count_ = 0;
     loaded_count_ = 0;
+    background_done_ = 0;
+    background_total_ = 0;
     loaded_paths_.clear();
     scan_duration_ = 0;
     info_label_->clear();
@@ -506,6 +581,7 @@ void main_window::show_image_viewer(const QString& path, const std::vector<QStri
     if (viewer_window_ == nullptr)
     {
         viewer_window_ = new image_viewer_window(this);
+        viewer_window_->set_cache_budget(memory_budget_->viewer_cache_bytes());
         viewer_window_->setWindowFlags(Qt::Window);
         connect(viewer_window_,
                 &image_viewer_window::current_image_changed,
@@ -556,25 +632,122 @@ void main_window::on_scan_all_finished(int total, qint64 duration, int session_i
     scan_duration_ = duration;
     total_count_ = total;
     scene_->layout_models(view_->viewport()->width());
+    scene_->start_background_pass();
     QMetaObject::invokeMethod(view_, [this]() { view_->check_visible_area(); }, Qt::QueuedConnection);
     update_status_bar();
 }
 
-void main_window::on_image_loaded_stat(quint64 /*id*/, const QString& path, const QImage& /*image*/, int session_id)
+void main_window::drain_results()
 {
-    if (session_id != current_scan_session_id_ || loaded_paths_.contains(path))
+    QElapsedTimer budget;
+    budget.start();
+
+    std::vector<thumbnail_result> batch;
+    batch.reserve(kDrainChunk);
+    bool drained = false;
+    qint64 conversion_ns = 0;
+    while (!drained && budget.elapsed() < kDrainBudgetMs)
     {
-        return;
+        thumbnail_result result;
+        while (batch.size() < static_cast<size_t>(kDrainChunk) && image_loader_->take_result(result))
+        {
+            batch.push_back(std::move(result));
+        }
+        drained = batch.size() < static_cast<size_t>(kDrainChunk);
+
+        if (!batch.empty())
+        {
+            on_images_loaded_stat(batch);
+            conversion_ns += scene_->on_images_loaded(std::move(batch));
+            batch = {};
+            batch.reserve(kDrainChunk);
+        }
     }
 
-    loaded_paths_.insert(path);
-    loaded_count_ = loaded_paths_.size();
-    update_status_bar();
+    if (frame_conversion_us_ != conversion_ns / 1000)
+    {
+        frame_conversion_us_ = conversion_ns / 1000;
+        update_status_bar();
+    }
+
+    if (drained)
+    {
+        drain_timer_->stop();
+    }
+}
+
+void main_window::on_images_loaded_stat(const std::vector<thumbnail_result>& results)
+{
+    const int previous_count = loaded_count_;
+    for (const auto& result : results)
+    {
+        if (result.session_id == current_scan_session_id_ && (result.broken || !result.image.isNull()))
+        {
+            loaded_paths_.insert(result.path);
+        }
+    }
+
+    loaded_count_ = static_cast<int>(loaded_paths_.size());
+    if (loaded_count_ != previous_count)
+    {
+        update_status_bar();
+    }
+}
+
+void main_window::refresh_cache_stats()
+{
+    quint64 hits = 0;
+    quint64 lookups = 0;
+    QStringList shard_lines;
+    const auto shard_stats = image_loader_->memory_cache_stats();
+    for (size_t i = 0; i < shard_stats.size(); ++i)
+    {
+        const auto& shard = shard_stats[i];
+        const quint64 shard_lookups = shard.hits + shard.misses;
+        hits += shard.hits;
+        lookups += shard_lookups;
+        shard_lines.append(QString("shard %1: hit %2% of %3, lock wait %4 us, %5 KB")
+                               .arg(i)
+                               .arg(shard_lookups > 0 ? 100.0 * static_cast<double>(shard.hits) / static_cast<double>(shard_lookups) : 0.0, 0, 'f', 1)
+                               .arg(shard_lookups)
+                               .arg(shard.lock_wait_ns / 1000)
+                               .arg(shard.bytes / 1024));
+    }
+    const auto compressed = image_loader_->compressed_cache_stats();
+    const quint64 compressed_lookups = compressed.hits + compressed.misses;
+    hits += compressed.hits;
+    shard_lines.append(QString("compressed: hit %1% of %2, %3 entries, %4 KB (%5 KB raw)")
+                           .arg(compressed_lookups > 0 ? 100.0 * static_cast<double>(compressed.hits) / static_cast<double>(compressed_lookups) : 0.0,
+                                0,
+                                'f',
+                                1)
+                           .arg(compressed_lookups)
+                           .arg(compressed.entries)
+                           .arg(compressed.bytes / 1024)
+                           .arg(compressed.raw_bytes / 1024));
+    status_label_->setToolTip(shard_lines.join('\n'));
+
+    const double hit_percent = lookups > 0 ? 100.0 * static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+    if (hit_percent != cache_hit_percent_)
+    {
+        cache_hit_percent_ = hit_percent;
+        update_status_bar();
+    }
 }
 
 void main_window::update_status_bar()
 {
-    QString status = QString("Scan+Layout: %1 ms | Loaded: %2 / %3").arg(scan_duration_).arg(loaded_count_).arg(total_count_);
+    QString status = QString("Scan+Layout: %1 ms | Loaded: %2 / %3 | GUI convert: %4 us/frame | Cache hit: %5%")
+                         .arg(scan_duration_)
+                         .arg(loaded_count_)
+                         .arg(total_count_)
+                         .arg(frame_conversion_us_)
+                         .arg(cache_hit_percent_, 0, 'f', 1);
+
+    if (background_total_ > 0)
+    {
+        status += QString(" | Pregenerated: %1 / %2").arg(background_done_).arg(background_total_);
+    }
 
     if (loaded_count_ == total_count_ && total_count_ > 0)
     {
@@ -15,12 +15,14 @@
 #include "file_scanner.h"
 
 class QImage;
+class QTimer;
 class QAction;
 class QActionGroup;
 class waterfall_view;
 class waterfall_scene;
 class image_loader;
 class image_viewer_window;
+class memory_budget;
 
 class main_window : public QMainWindow
 {
@@ -43,6 +45,7 @@ class main_window : public QMainWindow
     void setup_worker();
     void setup_scanner();
     void update_status_bar();
+    void refresh_cache_stats();
     void load_settings();
     void save_settings() const;
     void prune_recent_paths();
@@ -52,7 +55,8 @@ class main_window : public QMainWindow
     void show_image_viewer(const QString& path, const std::vector<QString>& image_list);
 
     void on_add_folder();
-    void on_image_loaded_stat(quint64 id, const QString& path, const QImage& image, int session_id);
+    void drain_results();
+    void on_images_loaded_stat(const std::vector<thumbnail_result>& results);
     void on_selection_changed();
     void on_image_double_clicked(const QString& path);
     void on_open_recent_path(const QString& path);
@@ -75,6 +79,9 @@ class main_window : public QMainWindow
     waterfall_scene* scene_ = nullptr;
     QThread* worker_thread_ = nullptr;
     image_loader* image_loader_ = nullptr;
+    QTimer* drain_timer_ = nullptr;
+    QTimer* cache_stats_timer_ = nullptr;
+    memory_budget* memory_budget_ = nullptr;
     QThread* scan_thread_ = nullptr;
     file_scanner* file_scanner_ = nullptr;
     QLabel* status_label_ = nullptr;
@@ -82,6 +89,10 @@ class main_window : public QMainWindow
     qint64 scan_duration_ = 0;
     int total_count_ = 0;
     int loaded_count_ = 0;
+    int background_done_ = 0;
+    int background_total_ = 0;
+    qint64 frame_conversion_us_ = 0;
+    double cache_hit_percent_ = 0.0;
     QSet<QString> loaded_paths_;
     QStringList recent_folder_paths_;
     QStringList recent_image_paths_;
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <QFile>
+#include <QTimer>
+#include "common_types.h"
+#include "memory_budget.h"
+
+namespace
+{
+constexpr qint64 kMiB = 1024LL * 1024;
+constexpr qint64 kDefaultThumbnailCacheBytes = 200 * kMiB;
+constexpr qint64 kMinThumbnailCacheBytes = 64 * kMiB;
+constexpr qint64 kMaxThumbnailCacheBytes = 2048 * kMiB;
+constexpr qint64 kMinViewerCacheBytes = 64 * kMiB;
+constexpr qint64 kMaxViewerCacheBytes = 1024 * kMiB;
+constexpr int kThumbnailShareDivisor = 16;
+constexpr int kViewerShareDivisor = 32;
+constexpr int kPollIntervalMs = 2000;
+constexpr double kPressureAvg10 = 10.0;
+constexpr double kCalmAvg10 = 1.0;
+constexpr int kCalmPollsBeforeGrow = 3;
+constexpr double kMinScale = 0.25;
+constexpr double kShrinkFactor = 0.5;
+constexpr double kGrowFactor = 1.25;
+
+QByteArray read_small_file(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return {};
+    }
+    return file.read(64 * 1024);
+}
+
+qint64 read_limit_file(const QString& path)
+{
+    const QByteArray value = read_small_file(path).trimmed();
+    if (value.isEmpty() || value == "max")
+    {
+        return 0;
+    }
+    bool ok = false;
+    const qint64 bytes = value.toLongLong(&ok);
+    constexpr qint64 kUnlimitedThreshold = 1LL << 60;
+    return ok && bytes > 0 && bytes < kUnlimitedThreshold ? bytes : 0;
+}
+
+// MemAvailable rather than MemTotal: the budget is a share of what can be had without swapping.
+qint64 read_meminfo_available()
+{
+    const QList<QByteArray> lines = read_small_file("/proc/meminfo").split('\n');
+    for (const QByteArray& line : lines)
+    {
+        if (line.startsWith("MemAvailable:"))
+        {
+            const QList<QByteArray> fields = line.simplified().split(' ');
+            return fields.size() >= 2 ? fields[1].toLongLong() * 1024 : 0;
+        }
+    }
+    return 0;
+}
+
+qint64 share_of(qint64 limit, int divisor, qint64 min_bytes, qint64 max_bytes, double scale)
+{
+    const qint64 base = std::clamp(limit / divisor, min_bytes, max_bytes);
+    return std::max(min_bytes / 2, static_cast<qint64>(static_cast<double>(base) * scale));
+}
+}
+
+memory_budget::memory_budget(QObject* parent) : QObject(parent) { detect_limit(); }
+
+void memory_budget::start()
+{
+    if (poll_timer_ != nullptr)
+    {
+        return;
+    }
+
+    last_events_ = read_cgroup_pressure_events();
+    poll_timer_ = new QTimer(this);
+    poll_timer_->setInterval(kPollIntervalMs);
+    connect(poll_timer_, &QTimer::timeout, this, &memory_budget::poll_pressure);
+    poll_timer_->start();
+}
+
+qint64 memory_budget::thumbnail_cache_bytes() const
+{
+    if (limit_bytes_ <= 0)
+    {
+        return static_cast<qint64>(static_cast<double>(kDefaultThumbnailCacheBytes) * scale_);
+    }
+    return share_of(limit_bytes_, kThumbnailShareDivisor, kMinThumbnailCacheBytes, kMaxThumbnailCacheBytes, scale_);
+}
+
+qint64 memory_budget::viewer_cache_bytes() const
+{
+    if (limit_bytes_ <= 0)
+    {
+        return static_cast<qint64>(static_cast<double>(kMaxImageAllocMB) * kMiB * scale_);
+    }
+    return share_of(limit_bytes_, kViewerShareDivisor, kMinViewerCacheBytes, kMaxViewerCacheBytes, scale_);
+}
+
+void memory_budget::detect_limit()
+{
+    qint64 cgroup_limit = 0;
+    const QList<QByteArray> lines = read_small_file("/proc/self/cgroup").split('\n');
+    for (const QByteArray& line : lines)
+    {
+        const QList<QByteArray> fields = line.split(':');
+        if (fields.size() < 3)
+        {
+            continue;
+        }
+
+        const QString relative = QString::fromUtf8(fields[2]);
+        if (fields[0] == "0" && fields[1].isEmpty())
+        {
+            cgroup_dir_ = "/sys/fs/cgroup" + (relative == "/" ? QString() : relative);
+            const qint64 max = read_limit_file(cgroup_dir_ + "/memory.max");
+            const qint64 high = read_limit_file(cgroup_dir_ + "/memory.high");
+            const qint64 unified_limit = max > 0 && high > 0 ? std::min(max, high) : std::max(max, high);
+            cgroup_limit = unified_limit > 0 ? unified_limit : cgroup_limit;
+        }
+        else if (fields[1].split(',').contains("memory"))
+        {
+            cgroup_limit = read_limit_file("/sys/fs/cgroup/memory" + relative + "/memory.limit_in_bytes");
+            if (cgroup_limit == 0)
+            {
+                cgroup_limit = read_limit_file("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+            }
+            break;
+        }
+    }
+
+    const qint64 available = read_meminfo_available();
+    limit_bytes_ = cgroup_limit > 0 && available > 0 ? std::min(cgroup_limit, available) : std::max(cgroup_limit, available);
+}
+
+double memory_budget::read_pressure_avg10() const
+{
+    QByteArray pressure = cgroup_dir_.isEmpty() ? QByteArray() : read_small_file(cgroup_dir_ + "/memory.pressure");
+    if (pressure.isEmpty())
+    {
+        pressure = read_small_file("/proc/pressure/memory");
+    }
+
+    const QList<QByteArray> lines = pressure.split('\n');
+    for (const QByteArray& line : lines)
+    {
+        if (!line.startsWith("some "))
+        {
+            continue;
+        }
+        for (const QByteArray& field : line.split(' '))
+        {
+            if (field.startsWith("avg10="))
+            {
+                return field.mid(6).toDouble();
+            }
+        }
+    }
+    return 0.0;
+}
+
+quint64 memory_budget::read_cgroup_pressure_events() const
+{
+    if (cgroup_dir_.isEmpty())
+    {
+        return 0;
+    }
+
+    quint64 events = 0;
+    const QList<QByteArray> lines = read_small_file(cgroup_dir_ + "/memory.events").split('\n');
+    for (const QByteArray& line : lines)
+    {
+        const QList<QByteArray> fields = line.split(' ');
+        if (fields.size() == 2 && (fields[0] == "high" || fields[0] == "max" || fields[0] == "oom"))
+        {
+            events += fields[1].toULongLong();
+        }
+    }
+    return events;
+}
+
+void memory_budget::poll_pressure()
+{
+    const double avg10 = read_pressure_avg10();
+    const quint64 events = read_cgroup_pressure_events();
+    const bool new_events = events > last_events_;
+    last_events_ = events;
+
+    const double previous_scale = scale_;
+    if (avg10 >= kPressureAvg10 || new_events)
+    {
+        scale_ = std::max(kMinScale, scale_ * kShrinkFactor);
+        calm_polls_ = 0;
+    }
+    else if (avg10 < kCalmAvg10 && scale_ < 1.0)
+    {
+        if (++calm_polls_ >= kCalmPollsBeforeGrow)
+        {
+            scale_ = std::min(1.0, scale_ * kGrowFactor);
+            calm_polls_ = 0;
+        }
+    }
+    else
+    {
+        calm_polls_ = 0;
+    }
+
+    if (scale_ != previous_scale)
+    {
+        emit budgets_changed(thumbnail_cache_bytes(), viewer_cache_bytes());
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef IMAGE_VIEWER_MEMORY_BUDGET_H
+#define IMAGE_VIEWER_MEMORY_BUDGET_H
+
+#include <QObject>
+#include <QString>
+
+class QTimer;
+
+class memory_budget : public QObject
+{
+    Q_OBJECT
+
+   public:
+    explicit memory_budget(QObject* parent = nullptr);
+
+    void start();
+    [[nodiscard]] qint64 thumbnail_cache_bytes() const;
+    [[nodiscard]] qint64 viewer_cache_bytes() const;
+    [[nodiscard]] qint64 memory_limit_bytes() const { return limit_bytes_; }
+
+   signals:
+    void budgets_changed(qint64 thumbnail_cache_bytes, qint64 viewer_cache_bytes);
+
+   private:
+    void detect_limit();
+    void poll_pressure();
+    [[nodiscard]] double read_pressure_avg10() const;
+    [[nodiscard]] quint64 read_cgroup_pressure_events() const;
+
+   private:
+    QTimer* poll_timer_ = nullptr;
+    QString cgroup_dir_;
+    qint64 limit_bytes_ = 0;
+    double scale_ = 1.0;
+    quint64 last_events_ = 0;
+    int calm_polls_ = 0;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include <QHash>
+#include <QMutex>
+#include "path_registry.h"
+
+namespace
+{
+struct registry_state
+{
+    QMutex mutex;
+    QHash<QString, quint32> ids;
+    quint32 last_id = 0;
+};
+
+registry_state& state()
+{
+    static registry_state s;
+    return s;
+}
+}
+
+quint32 path_registry::intern(const QString& path)
+{
+    registry_state& s = state();
+    QMutexLocker locker(&s.mutex);
+    auto it = s.ids.constFind(path);
+    if (it != s.ids.constEnd())
+    {
+        return it.value();
+    }
+
+    const quint32 id = ++s.last_id;
+    s.ids.insert(path, id);
+    return id;
+}
+
+void path_registry::clear()
+{
+    registry_state& s = state();
+    QMutexLocker locker(&s.mutex);
+    s.ids.clear();
+}
@@ -0,0 +1,15 @@
+#ifndef IMAGE_VIEWER_PATH_REGISTRY_H
+#define IMAGE_VIEWER_PATH_REGISTRY_H
+
+#include <QString>
+
+// Ids stay stable for the life of the process so rescans hit the memory caches keyed by them. The table only shrinks
+// on clear(), which must go together with dropping those caches; ids are never reused, so a stale key can only miss.
+class path_registry
+{
+   public:
+    [[nodiscard]] static quint32 intern(const QString& path);
+    static void clear();
+};
+
+#endif
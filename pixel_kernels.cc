@@ -0,0 +1,590 @@
+#include <cstring>
+#include "pixel_kernels.h"
+
+#if defined(IMAGEVIEWER_SIMD_X86)
+#include <immintrin.h>
+#elif defined(IMAGEVIEWER_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+constexpr quint32 kOpaque = 0xff000000U;
+
+struct kernel_set
+{
+    void (*premultiply_row)(const quint32* src, quint32* dst, int width);
+    void (*rgb888_row)(const uchar* src, quint32* dst, int width);
+    void (*gray_row)(const uchar* src, quint32* dst, int width);
+    void (*reverse_row)(const quint32* src, quint32* dst, int width);
+    void (*transpose)(const QImage& src, QImage& dst, bool mirror, bool flip);
+};
+
+struct transpose_layout
+{
+    const uchar* src_bits;
+    qsizetype src_stride;
+    uchar* dst_bits;
+    qsizetype dst_stride;
+    int width;
+    int height;
+    bool mirror;
+    bool flip;
+
+    transpose_layout(const QImage& src, QImage& dst, bool mirror_x, bool flip_y)
+        : src_bits(src.constBits()),
+          src_stride(src.bytesPerLine()),
+          dst_bits(dst.bits()),
+          dst_stride(dst.bytesPerLine()),
+          width(src.width()),
+          height(src.height()),
+          mirror(mirror_x),
+          flip(flip_y)
+    {
+    }
+
+    [[nodiscard]] const quint32* src_row(int y) const { return reinterpret_cast<const quint32*>(src_bits + (y * src_stride)); }
+    [[nodiscard]] quint32* dst_row_for_column(int x) const
+    {
+        return reinterpret_cast<quint32*>(dst_bits + (static_cast<qsizetype>(mirror ? width - 1 - x : x) * dst_stride));
+    }
+    [[nodiscard]] int dst_column_for_row(int y) const { return flip ? y : height - 1 - y; }
+
+    void move_pixels(int x_begin, int x_end, int y_begin, int y_end) const
+    {
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            const quint32* src = src_row(y);
+            const int dst_x = dst_column_for_row(y);
+            for (int x = x_begin; x < x_end; ++x)
+            {
+                dst_row_for_column(x)[dst_x] = src[x];
+            }
+        }
+    }
+};
+
+void premultiply_row_scalar(const quint32* src, quint32* dst, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        dst[x] = qPremultiply(src[x]);
+    }
+}
+
+void rgb888_row_scalar(const uchar* src, quint32* dst, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        const uchar* p = src + (static_cast<qsizetype>(x) * 3);
+        dst[x] = kOpaque | (static_cast<quint32>(p[0]) << 16) | (static_cast<quint32>(p[1]) << 8) | p[2];
+    }
+}
+
+void gray_row_scalar(const uchar* src, quint32* dst, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        dst[x] = kOpaque | (src[x] * 0x010101U);
+    }
+}
+
+void reverse_row_scalar(const quint32* src, quint32* dst, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        dst[x] = src[width - 1 - x];
+    }
+}
+
+void transpose_scalar(const QImage& src, QImage& dst, bool mirror, bool flip)
+{
+    const transpose_layout layout(src, dst, mirror, flip);
+    layout.move_pixels(0, layout.width, 0, layout.height);
+}
+
+template<typename Block>
+void transpose_blocks(const QImage& src, QImage& dst, bool mirror, bool flip)
+{
+    constexpr int n = Block::kSize;
+    const transpose_layout layout(src, dst, mirror, flip);
+    const int block_width = layout.width - (layout.width % n);
+    const int block_height = layout.height - (layout.height % n);
+
+    for (int y = 0; y < block_height; y += n)
+    {
+        const int dst_x = flip ? y : layout.height - y - n;
+        for (int x = 0; x < block_width; x += n)
+        {
+            quint32* dst_rows[n];
+            for (int j = 0; j < n; ++j)
+            {
+                dst_rows[j] = layout.dst_row_for_column(x + j) + dst_x;
+            }
+            Block::transpose(layout.src_row(y) + x, layout.src_stride, dst_rows, !flip);
+        }
+    }
+    layout.move_pixels(block_width, layout.width, 0, layout.height);
+    layout.move_pixels(0, block_width, block_height, layout.height);
+}
+
+#ifdef IMAGEVIEWER_SIMD_X86
+__m128i premultiply_words_sse(__m128i words)
+{
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(words, 0xFF), 0xFF);
+    alpha = _mm_or_si128(_mm_andnot_si128(_mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0), alpha), _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+    const __m128i product = _mm_mullo_epi16(words, alpha);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), _mm_set1_epi16(0x80)), 8);
+}
+
+__attribute__((target("sse4.1"))) void premultiply_row_sse41(const quint32* src, quint32* dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        const __m128i lo = premultiply_words_sse(_mm_unpacklo_epi8(pixels, zero));
+        const __m128i hi = premultiply_words_sse(_mm_unpackhi_epi8(pixels, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+    }
+    premultiply_row_scalar(src + x, dst + x, width - x);
+}
+
+__attribute__((target("sse4.1"))) void rgb888_row_sse41(const uchar* src, quint32* dst, int width)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(kOpaque));
+    int x = 0;
+    for (; x + 6 <= width; x += 4)
+    {
+        const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (static_cast<qsizetype>(x) * 3)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+    }
+    rgb888_row_scalar(src + (static_cast<qsizetype>(x) * 3), dst + x, width - x);
+}
+
+__attribute__((target("sse4.1"))) void gray_row_sse41(const uchar* src, quint32* dst, int width)
+{
+    const __m128i opaque = _mm_set1_epi8(static_cast<char>(0xff));
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        const __m128i lo_pairs = _mm_unpacklo_epi8(gray, gray);
+        const __m128i hi_pairs = _mm_unpackhi_epi8(gray, gray);
+        const __m128i lo_alpha = _mm_unpacklo_epi8(gray, opaque);
+        const __m128i hi_alpha = _mm_unpackhi_epi8(gray, opaque);
+        auto* out = reinterpret_cast<__m128i*>(dst + x);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo_pairs, lo_alpha));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo_pairs, lo_alpha));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi_pairs, hi_alpha));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi_pairs, hi_alpha));
+    }
+    gray_row_scalar(src + x, dst + x, width - x);
+}
+
+void reverse_row_sse41(const quint32* src, quint32* dst, int width)
+{
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + width - x - 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_shuffle_epi32(pixels, 0x1B));
+    }
+    for (; x < width; ++x)
+    {
+        dst[x] = src[width - 1 - x];
+    }
+}
+
+struct block_sse41
+{
+    static constexpr int kSize = 4;
+
+    static void transpose(const quint32* src, qsizetype src_stride, quint32* const* dst_rows, bool reverse)
+    {
+        const auto* bytes = reinterpret_cast<const uchar*>(src);
+        const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+        const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + src_stride));
+        const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + (2 * src_stride)));
+        const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + (3 * src_stride)));
+        const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+        const __m128i columns[kSize] = {
+            _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1), _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)};
+        for (int j = 0; j < kSize; ++j)
+        {
+            const __m128i column = reverse ? _mm_shuffle_epi32(columns[j], 0x1B) : columns[j];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst_rows[j]), column);
+        }
+    }
+};
+
+__attribute__((target("avx2"))) __m256i premultiply_words_avx2(__m256i words)
+{
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(words, 0xFF), 0xFF);
+    alpha = _mm256_blend_epi16(alpha, _mm256_set1_epi16(255), 0x88);
+    const __m256i product = _mm256_mullo_epi16(words, alpha);
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), _mm256_set1_epi16(0x80)), 8);
+}
+
+__attribute__((target("avx2"))) void premultiply_row_avx2(const quint32* src, quint32* dst, int width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        const __m256i lo = premultiply_words_avx2(_mm256_unpacklo_epi8(pixels, zero));
+        const __m256i hi = premultiply_words_avx2(_mm256_unpackhi_epi8(pixels, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_packus_epi16(lo, hi));
+    }
+    premultiply_row_scalar(src + x, dst + x, width - x);
+}
+
+__attribute__((target("avx2"))) void rgb888_row_avx2(const uchar* src, quint32* dst, int width)
+{
+    const __m256i shuffle =
+        _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(kOpaque));
+    int x = 0;
+    for (; x + 10 <= width; x += 8)
+    {
+        const uchar* p = src + (static_cast<qsizetype>(x) * 3);
+        const __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+                                                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)),
+                                                     1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha));
+    }
+    rgb888_row_sse41(src + (static_cast<qsizetype>(x) * 3), dst + x, width - x);
+}
+
+__attribute__((target("avx2"))) void gray_row_avx2(const uchar* src, quint32* dst, int width)
+{
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(kOpaque));
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i gray = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x)));
+        const __m256i spread = _mm256_or_si256(_mm256_or_si256(gray, _mm256_slli_epi32(gray, 8)), _mm256_slli_epi32(gray, 16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(spread, alpha));
+    }
+    gray_row_scalar(src + x, dst + x, width - x);
+}
+
+__attribute__((target("avx2"))) void reverse_row_avx2(const quint32* src, quint32* dst, int width)
+{
+    const __m256i reversed = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + width - x - 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_permutevar8x32_epi32(pixels, reversed));
+    }
+    for (; x < width; ++x)
+    {
+        dst[x] = src[width - 1 - x];
+    }
+}
+
+struct block_avx2
+{
+    static constexpr int kSize = 8;
+
+    __attribute__((target("avx2"))) static void transpose(const quint32* src, qsizetype src_stride, quint32* const* dst_rows, bool reverse)
+    {
+        const auto* bytes = reinterpret_cast<const uchar*>(src);
+        __m256i rows[kSize];
+        for (int i = 0; i < kSize; ++i)
+        {
+            rows[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + (i * src_stride)));
+        }
+
+        __m256i pairs[kSize];
+        for (int i = 0; i < kSize; i += 2)
+        {
+            pairs[i] = _mm256_unpacklo_epi32(rows[i], rows[i + 1]);
+            pairs[i + 1] = _mm256_unpackhi_epi32(rows[i], rows[i + 1]);
+        }
+
+        __m256i quads[kSize];
+        for (int i = 0; i < kSize; i += 4)
+        {
+            quads[i] = _mm256_unpacklo_epi64(pairs[i], pairs[i + 2]);
+            quads[i + 1] = _mm256_unpackhi_epi64(pairs[i], pairs[i + 2]);
+            quads[i + 2] = _mm256_unpacklo_epi64(pairs[i + 1], pairs[i + 3]);
+            quads[i + 3] = _mm256_unpackhi_epi64(pairs[i + 1], pairs[i + 3]);
+        }
+
+        const __m256i reversed = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        for (int j = 0; j < kSize / 2; ++j)
+        {
+            const __m256i low = _mm256_permute2x128_si256(quads[j], quads[j + 4], 0x20);
+            const __m256i high = _mm256_permute2x128_si256(quads[j], quads[j + 4], 0x31);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst_rows[j]), reverse ? _mm256_permutevar8x32_epi32(low, reversed) : low);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst_rows[j + 4]), reverse ? _mm256_permutevar8x32_epi32(high, reversed) : high);
+        }
+    }
+};
+#endif
+
+#ifdef IMAGEVIEWER_SIMD_NEON
+uint8x8_t premultiply_channel_neon(uint8x8_t channel, uint8x8_t alpha)
+{
+    const uint16x8_t product = vmull_u8(channel, alpha);
+    return vraddhn_u16(product, vshrq_n_u16(product, 8));
+}
+
+void premultiply_row_neon(const quint32* src, quint32* dst, int width)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        uint8x8x4_t pixels = vld4_u8(reinterpret_cast<const uint8_t*>(src + x));
+        pixels.val[0] = premultiply_channel_neon(pixels.val[0], pixels.val[3]);
+        pixels.val[1] = premultiply_channel_neon(pixels.val[1], pixels.val[3]);
+        pixels.val[2] = premultiply_channel_neon(pixels.val[2], pixels.val[3]);
+        vst4_u8(reinterpret_cast<uint8_t*>(dst + x), pixels);
+    }
+    premultiply_row_scalar(src + x, dst + x, width - x);
+}
+
+void rgb888_row_neon(const uchar* src, quint32* dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const uint8x16x3_t rgb = vld3q_u8(src + (static_cast<qsizetype>(x) * 3));
+        const uint8x16x4_t bgra = {{rgb.val[2], rgb.val[1], rgb.val[0], vdupq_n_u8(0xff)}};
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + x), bgra);
+    }
+    rgb888_row_scalar(src + (static_cast<qsizetype>(x) * 3), dst + x, width - x);
+}
+
+void gray_row_neon(const uchar* src, quint32* dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const uint8x16_t gray = vld1q_u8(src + x);
+        const uint8x16x4_t bgra = {{gray, gray, gray, vdupq_n_u8(0xff)}};
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + x), bgra);
+    }
+    gray_row_scalar(src + x, dst + x, width - x);
+}
+
+uint32x4_t reverse_neon(uint32x4_t pixels)
+{
+    const uint32x4_t swapped = vrev64q_u32(pixels);
+    return vextq_u32(swapped, swapped, 2);
+}
+
+void reverse_row_neon(const quint32* src, quint32* dst, int width)
+{
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        vst1q_u32(dst + x, reverse_neon(vld1q_u32(src + width - x - 4)));
+    }
+    for (; x < width; ++x)
+    {
+        dst[x] = src[width - 1 - x];
+    }
+}
+
+struct block_neon
+{
+    static constexpr int kSize = 4;
+
+    static void transpose(const quint32* src, qsizetype src_stride, quint32* const* dst_rows, bool reverse)
+    {
+        const auto* bytes = reinterpret_cast<const uchar*>(src);
+        const uint32x4x2_t upper = vtrnq_u32(vld1q_u32(reinterpret_cast<const quint32*>(bytes)),
+                                             vld1q_u32(reinterpret_cast<const quint32*>(bytes + src_stride)));
+        const uint32x4x2_t lower = vtrnq_u32(vld1q_u32(reinterpret_cast<const quint32*>(bytes + (2 * src_stride))),
+                                             vld1q_u32(reinterpret_cast<const quint32*>(bytes + (3 * src_stride))));
+        const uint32x4_t columns[kSize] = {vcombine_u32(vget_low_u32(upper.val[0]), vget_low_u32(lower.val[0])),
+                                                       vcombine_u32(vget_low_u32(upper.val[1]), vget_low_u32(lower.val[1])),
+                                                       vcombine_u32(vget_high_u32(upper.val[0]), vget_high_u32(lower.val[0])),
+                                                       vcombine_u32(vget_high_u32(upper.val[1]), vget_high_u32(lower.val[1]))};
+        for (int j = 0; j < kSize; ++j)
+        {
+            vst1q_u32(dst_rows[j], reverse ? reverse_neon(columns[j]) : columns[j]);
+        }
+    }
+};
+#endif
+
+const kernel_set& kernels_for(cpu_features::simd_level level)
+{
+    static const kernel_set scalar{premultiply_row_scalar, rgb888_row_scalar, gray_row_scalar, reverse_row_scalar, transpose_scalar};
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+#ifdef IMAGEVIEWER_SIMD_X86
+    static const kernel_set sse41{
+        premultiply_row_sse41, rgb888_row_sse41, gray_row_sse41, reverse_row_sse41, transpose_blocks<block_sse41>};
+    static const kernel_set avx2{premultiply_row_avx2, rgb888_row_avx2, gray_row_avx2, reverse_row_avx2, transpose_blocks<block_avx2>};
+#endif
+#ifdef IMAGEVIEWER_SIMD_NEON
+    static const kernel_set neon{premultiply_row_neon, rgb888_row_neon, gray_row_neon, reverse_row_neon, transpose_blocks<block_neon>};
+#endif
+
+    switch (cpu_features::supports(level) ? level : cpu_features::simd_level::scalar)
+    {
+#ifdef IMAGEVIEWER_SIMD_X86
+        case cpu_features::simd_level::sse41:
+            return sse41;
+        case cpu_features::simd_level::avx2:
+            return avx2;
+#endif
+#ifdef IMAGEVIEWER_SIMD_NEON
+        case cpu_features::simd_level::neon:
+            return neon;
+#endif
+        default:
+            break;
+    }
+#else
+    Q_UNUSED(level);
+#endif
+    return scalar;
+}
+
+QImage with_metadata_of(QImage image, const QImage& source)
+{
+    image.setDevicePixelRatio(source.devicePixelRatio());
+    image.setDotsPerMeterX(source.dotsPerMeterX());
+    image.setDotsPerMeterY(source.dotsPerMeterY());
+    image.setColorSpace(source.colorSpace());
+    return image;
+}
+}
+
+namespace pixel_kernels
+{
+void premultiply_row(quint32* pixels, int width, cpu_features::simd_level level) { kernels_for(level).premultiply_row(pixels, pixels, width); }
+
+QImage to_premultiplied(QImage image, cpu_features::simd_level level)
+{
+    const kernel_set& kernels = kernels_for(level);
+    switch (image.format())
+    {
+        case QImage::Format_ARGB32_Premultiplied:
+            return image;
+        case QImage::Format_RGB32:
+            if (image.reinterpretAsFormat(QImage::Format_ARGB32_Premultiplied))
+            {
+                return image;
+            }
+            break;
+        case QImage::Format_ARGB32:
+            for (int y = 0; y < image.height(); ++y)
+            {
+                premultiply_row(reinterpret_cast<quint32*>(image.scanLine(y)), image.width(), level);
+            }
+            if (image.reinterpretAsFormat(QImage::Format_ARGB32_Premultiplied))
+            {
+                return image;
+            }
+            return QImage();
+        case QImage::Format_RGB888:
+        case QImage::Format_Grayscale8:
+        {
+            QImage converted(image.size(), QImage::Format_ARGB32_Premultiplied);
+            if (converted.isNull())
+            {
+                return converted;
+            }
+            const bool gray = image.format() == QImage::Format_Grayscale8;
+            for (int y = 0; y < image.height(); ++y)
+            {
+                auto* row = reinterpret_cast<quint32*>(converted.scanLine(y));
+                if (gray)
+                {
+                    kernels.gray_row(image.constScanLine(y), row, image.width());
+                }
+                else
+                {
+                    kernels.rgb888_row(image.constScanLine(y), row, image.width());
+                }
+            }
+            return with_metadata_of(std::move(converted), image);
+        }
+        default:
+            break;
+    }
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+QImage transformed(QImage image, QImageIOHandler::Transformations transformation, cpu_features::simd_level level)
+{
+    if (transformation == QImageIOHandler::TransformationNone || image.isNull())
+    {
+        return image;
+    }
+    if (image.depth() != 32)
+    {
+        image = to_premultiplied(std::move(image), level);
+    }
+
+    const kernel_set& kernels = kernels_for(level);
+    const bool mirror = transformation.testFlag(QImageIOHandler::TransformationMirror);
+    const bool flip = transformation.testFlag(QImageIOHandler::TransformationFlip);
+    if (transformation.testFlag(QImageIOHandler::TransformationRotate90))
+    {
+        QImage rotated(image.height(), image.width(), image.format());
+        if (rotated.isNull())
+        {
+            return rotated;
+        }
+        kernels.transpose(image, rotated, mirror, flip);
+        return with_metadata_of(std::move(rotated), image);
+    }
+
+    QImage result(image.size(), image.format());
+    if (result.isNull())
+    {
+        return result;
+    }
+    const auto row_bytes = static_cast<size_t>(image.width()) * 4;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        const uchar* src = image.constScanLine(flip ? image.height() - 1 - y : y);
+        uchar* dst = result.scanLine(y);
+        if (mirror)
+        {
+            kernels.reverse_row(reinterpret_cast<const quint32*>(src), reinterpret_cast<quint32*>(dst), image.width());
+        }
+        else
+        {
+            std::memcpy(dst, src, row_bytes);
+        }
+    }
+    return with_metadata_of(std::move(result), image);
+}
+
+QImageIOHandler::Transformations exif_transformation(int orientation)
+{
+    switch (orientation)
+    {
+        case 2:
+            return QImageIOHandler::TransformationMirror;
+        case 3:
+            return QImageIOHandler::TransformationRotate180;
+        case 4:
+            return QImageIOHandler::TransformationFlip;
+        case 5:
+            return QImageIOHandler::TransformationFlipAndRotate90;
+        case 6:
+            return QImageIOHandler::TransformationRotate90;
+        case 7:
+            return QImageIOHandler::TransformationMirrorAndRotate90;
+        case 8:
+            return QImageIOHandler::TransformationRotate270;
+        default:
+            return QImageIOHandler::TransformationNone;
+    }
+}
+}
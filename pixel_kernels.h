@@ -0,0 +1,18 @@
+#ifndef IMAGE_VIEWER_PIXEL_KERNELS_H
+#define IMAGE_VIEWER_PIXEL_KERNELS_H
+
+#include <QImage>
+#include <QImageIOHandler>
+#include "cpu_features.h"
+
+namespace pixel_kernels
+{
+void premultiply_row(quint32* pixels, int width, cpu_features::simd_level level = cpu_features::best_simd_level());
+[[nodiscard]] QImage to_premultiplied(QImage image, cpu_features::simd_level level = cpu_features::best_simd_level());
+[[nodiscard]] QImage transformed(QImage image,
+                                 QImageIOHandler::Transformations transformation,
+                                 cpu_features::simd_level level = cpu_features::best_simd_level());
+[[nodiscard]] QImageIOHandler::Transformations exif_transformation(int orientation);
+}
+
+#endif
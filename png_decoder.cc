@@ -0,0 +1,228 @@
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <png.h>
+#include "area_scaler.h"
+#include "pixel_kernels.h"
+#include "png_decoder.h"
+
+namespace
+{
+constexpr qsizetype kSignatureBytes = 8;
+// Adam7 passes 0, 0-2 and 0-4 complete regular lattices of every 8th, 4th and 2nd pixel; all seven give the full image.
+constexpr int kLatticeSteps[] = {8, 4, 2};
+constexpr int kPassesForStep8 = 1;
+constexpr int kPassesForStep4 = 3;
+constexpr int kPassesForStep2 = 5;
+constexpr int kAdam7Passes = 7;
+// A lattice is only used when it still has this many samples per target pixel, so the area filter hides the subsampling.
+constexpr int kLatticeOversample = 2;
+
+struct memory_reader
+{
+    const uchar* data = nullptr;
+    qsizetype size = 0;
+    qsizetype offset = 0;
+};
+
+struct decode_state
+{
+    memory_reader reader;
+    QSize bound;
+    const std::atomic<bool>* cancelled = nullptr;
+    std::unique_ptr<area_scaler> scaler;
+    std::vector<quint32> row;
+    std::vector<quint32> lattice;
+};
+
+void read_from_memory(png_structp png, png_bytep out, png_size_t length)
+{
+    auto* reader = static_cast<memory_reader*>(png_get_io_ptr(png));
+    if (reader->size - reader->offset < static_cast<qsizetype>(length))
+    {
+        png_error(png, "truncated PNG data");
+    }
+    std::memcpy(out, reader->data + reader->offset, length);
+    reader->offset += static_cast<qsizetype>(length);
+}
+
+void on_png_error(png_structp png, png_const_charp /*message*/) { png_longjmp(png, 1); }
+
+void on_png_warning(png_structp /*png*/, png_const_charp /*message*/) {}
+
+bool is_cancelled(const decode_state& state) { return state.cancelled != nullptr && state.cancelled->load(std::memory_order_relaxed); }
+
+int lattice_step(const QSize& full_size, const QSize& target_size)
+{
+    for (const int step : kLatticeSteps)
+    {
+        if ((full_size.width() + step - 1) / step >= target_size.width() * kLatticeOversample &&
+            (full_size.height() + step - 1) / step >= target_size.height() * kLatticeOversample)
+        {
+            return step;
+        }
+    }
+    return 1;
+}
+
+int passes_for_step(int step)
+{
+    switch (step)
+    {
+        case 8:
+            return kPassesForStep8;
+        case 4:
+            return kPassesForStep4;
+        case 2:
+            return kPassesForStep2;
+        default:
+            return kAdam7Passes;
+    }
+}
+
+// Reads the passes that make up the coarsest lattice still covering the target, scatters them into place and scales
+// the lattice. Without interlace handling libpng returns each pass as its own packed sub-image and skips empty passes.
+bool read_interlaced(png_structp png, png_uint_32 width, png_uint_32 height, const QSize& target_size, decode_state& state)
+{
+    const int step = lattice_step(QSize(static_cast<int>(width), static_cast<int>(height)), target_size);
+    const QSize lattice_size((static_cast<int>(width) + step - 1) / step, (static_cast<int>(height) + step - 1) / step);
+    state.scaler = std::make_unique<area_scaler>(lattice_size, target_size, QImage::Format_ARGB32_Premultiplied);
+    if (!state.scaler->is_valid())
+    {
+        return false;
+    }
+
+    const auto lattice_width = static_cast<size_t>(lattice_size.width());
+    state.lattice.assign(lattice_width * static_cast<size_t>(lattice_size.height()), 0);
+    state.row.resize(static_cast<size_t>(width));
+    for (int pass = 0; pass < passes_for_step(step); ++pass)
+    {
+        const png_uint_32 columns = PNG_PASS_COLS(width, pass);
+        const png_uint_32 rows = PNG_PASS_ROWS(height, pass);
+        if (columns == 0 || rows == 0)
+        {
+            continue;
+        }
+
+        const size_t first_column = PNG_PASS_START_COL(pass) / step;
+        const size_t column_step = PNG_PASS_COL_OFFSET(pass) / step;
+        const size_t first_row = PNG_PASS_START_ROW(pass) / step;
+        const size_t row_step = PNG_PASS_ROW_OFFSET(pass) / step;
+        for (png_uint_32 y = 0; y < rows; ++y)
+        {
+            if (is_cancelled(state))
+            {
+                return false;
+            }
+            png_read_row(png, reinterpret_cast<png_bytep>(state.row.data()), nullptr);
+            quint32* out = state.lattice.data() + (first_row + y * row_step) * lattice_width + first_column;
+            for (png_uint_32 x = 0; x < columns; ++x)
+            {
+                out[x * column_step] = state.row[x];
+            }
+        }
+    }
+
+    for (int y = 0; y < lattice_size.height(); ++y)
+    {
+        quint32* row = state.lattice.data() + static_cast<size_t>(y) * lattice_width;
+        pixel_kernels::premultiply_row(row, lattice_size.width());
+        state.scaler->push_row(reinterpret_cast<const uchar*>(row));
+    }
+    return true;
+}
+
+bool stream_rows(png_structp png, png_infop info, decode_state& state)
+{
+    if (setjmp(png_jmpbuf(png)) != 0)
+    {
+        return false;
+    }
+
+    png_set_read_fn(png, &state.reader, read_from_memory);
+    png_read_info(png, info);
+
+    const png_uint_32 width = png_get_image_width(png, info);
+    const png_uint_32 height = png_get_image_height(png, info);
+    const bool interlaced = png_get_interlace_type(png, info) != PNG_INTERLACE_NONE;
+
+    png_set_expand(png);
+    png_set_strip_16(png);
+    png_set_gray_to_rgb(png);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    png_set_bgr(png);
+    png_set_filler(png, 0xff, PNG_FILLER_AFTER);
+#else
+    png_set_swap_alpha(png);
+    png_set_filler(png, 0xff, PNG_FILLER_BEFORE);
+#endif
+    png_read_update_info(png, info);
+    if (png_get_channels(png, info) != 4 || png_get_bit_depth(png, info) != 8)
+    {
+        return false;
+    }
+
+    const QSize full_size(static_cast<int>(width), static_cast<int>(height));
+    const QSize target_size = full_size.scaled(state.bound, Qt::KeepAspectRatio);
+    if (interlaced)
+    {
+        return read_interlaced(png, width, height, target_size, state);
+    }
+
+    state.scaler = std::make_unique<area_scaler>(full_size, target_size, QImage::Format_ARGB32_Premultiplied);
+    if (!state.scaler->is_valid())
+    {
+        return false;
+    }
+
+    state.row.resize(static_cast<size_t>(width));
+    for (int y = 0; y < full_size.height(); ++y)
+    {
+        if (is_cancelled(state))
+        {
+            return false;
+        }
+        png_read_row(png, reinterpret_cast<png_bytep>(state.row.data()), nullptr);
+        pixel_kernels::premultiply_row(state.row.data(), full_size.width());
+        state.scaler->push_row(reinterpret_cast<const uchar*>(state.row.data()));
+    }
+    return true;
+}
+}
+
+namespace png_decoder
+{
+bool is_png(const QByteArray& data)
+{
+    return data.size() > kSignatureBytes && png_sig_cmp(reinterpret_cast<png_const_bytep>(data.constData()), 0, kSignatureBytes) == 0;
+}
+
+QImage decode_thumbnail(const QByteArray& data, const QSize& target_size, const std::atomic<bool>* cancelled)
+{
+    if (!is_png(data) || target_size.isEmpty())
+    {
+        return QImage();
+    }
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, on_png_error, on_png_warning);
+    if (png == nullptr)
+    {
+        return QImage();
+    }
+    png_infop info = png_create_info_struct(png);
+    if (info == nullptr)
+    {
+        png_destroy_read_struct(&png, nullptr, nullptr);
+        return QImage();
+    }
+
+    decode_state state;
+    state.reader = {reinterpret_cast<const uchar*>(data.constData()), data.size(), 0};
+    state.bound = target_size;
+    state.cancelled = cancelled;
+    const bool decoded = stream_rows(png, info, state);
+    png_destroy_read_struct(&png, &info, nullptr);
+
+    return decoded ? state.scaler->take_image() : QImage();
+}
+}
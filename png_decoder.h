@@ -0,0 +1,15 @@
+#ifndef IMAGE_VIEWER_PNG_DECODER_H
+#define IMAGE_VIEWER_PNG_DECODER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QSize>
+#include <atomic>
+
+namespace png_decoder
+{
+[[nodiscard]] bool is_png(const QByteArray& data);
+[[nodiscard]] QImage decode_thumbnail(const QByteArray& data, const QSize& target_size, const std::atomic<bool>* cancelled = nullptr);
+}
+
+#endif
@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <QFile>
+#include <QThread>
+#include "read_ahead.h"
+
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+namespace
+{
+constexpr int kMaxDepth = 64;
+constexpr int kAdmissionFactor = 2;
+constexpr qint64 kMaxReadAheadBytes = 64LL * 1024 * 1024;
+// Bytes reserved by queued-for-decode and in-flight reads together; nothing else bounds this memory.
+constexpr qint64 kMaxHeldBytes = 128LL * 1024 * 1024;
+}
+
+read_ahead::read_ahead(source_filter needs_source, int depth) : needs_source_(std::move(needs_source))
+{
+    set_depth(depth);
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+    io_thread_ = QThread::create([this]() { io_loop(); });
+    io_thread_->setObjectName("thumbnail_read_ahead");
+    io_thread_->start();
+#endif
+}
+
+read_ahead::~read_ahead()
+{
+    stop_ = true;
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+    {
+        QMutexLocker locker(&mutex_);
+        work_available_.wakeAll();
+    }
+    io_thread_->wait();
+    delete io_thread_;
+#else
+    pool_.clear();
+    pool_.waitForDone();
+#endif
+}
+
+void read_ahead::set_depth(int depth)
+{
+    depth_.store(std::clamp(depth, 0, kMaxDepth), std::memory_order_relaxed);
+#ifndef IMAGEVIEWER_HAVE_LIBURING
+    pool_.setMaxThreadCount(std::max(1, this->depth()));
+#endif
+}
+
+void read_ahead::prefetch(const std::vector<load_task>& tasks)
+{
+    const int max_entries = depth() * kAdmissionFactor;
+    if (max_entries == 0 || tasks.empty())
+    {
+        return;
+    }
+
+    QMutexLocker locker(&mutex_);
+    for (const auto& task : tasks)
+    {
+        if (entries_.size() >= max_entries || held_bytes_ >= kMaxHeldBytes)
+        {
+            break;
+        }
+        if (entries_.contains(task.id))
+        {
+            continue;
+        }
+
+        entries_.insert(task.id, entry{});
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+        pending_.push_back(task);
+#else
+        pool_.start([this, task]() { read_blocking(task); });
+#endif
+    }
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+    work_available_.wakeOne();
+#endif
+}
+
+QByteArray read_ahead::take(quint64 id)
+{
+    QMutexLocker locker(&mutex_);
+    for (;;)
+    {
+        auto it = entries_.find(id);
+        if (it == entries_.end())
+        {
+            return QByteArray();
+        }
+
+        switch (it->status)
+        {
+            case state::queued:
+                erase_entry(it);
+                return QByteArray();
+            case state::reading:
+                read_done_.wait(&mutex_);
+                break;
+            case state::ready:
+            {
+                QByteArray data = std::move(it->data);
+                erase_entry(it);
+                return data;
+            }
+        }
+    }
+}
+
+void read_ahead::discard(const QList<quint64>& ids)
+{
+    QMutexLocker locker(&mutex_);
+    for (const quint64 id : ids)
+    {
+        auto it = entries_.find(id);
+        if (it != entries_.end())
+        {
+            erase_entry(it);
+        }
+    }
+}
+
+void read_ahead::clear()
+{
+    QMutexLocker locker(&mutex_);
+    entries_.clear();
+    held_bytes_ = 0;
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+    pending_.clear();
+#endif
+}
+
+bool read_ahead::begin_read(const load_task& task)
+{
+    {
+        QMutexLocker locker(&mutex_);
+        auto it = entries_.find(task.id);
+        if (it == entries_.end() || it->status != state::queued)
+        {
+            return false;
+        }
+        it->status = state::reading;
+    }
+
+    if (!needs_source_(task))
+    {
+        finish_read(task.id, QByteArray());
+        return false;
+    }
+    return true;
+}
+
+bool read_ahead::reserve(quint64 id, qint64 bytes)
+{
+    if (bytes <= 0 || bytes > kMaxReadAheadBytes)
+    {
+        return false;
+    }
+
+    QMutexLocker locker(&mutex_);
+    auto it = entries_.find(id);
+    if (it == entries_.end() || held_bytes_ + bytes > kMaxHeldBytes)
+    {
+        return false;
+    }
+    it->reserved_bytes = bytes;
+    held_bytes_ += bytes;
+    return true;
+}
+
+QByteArray read_ahead::read_file(const load_task& task)
+{
+    QFile file(task.path);
+    if (!file.open(QIODevice::ReadOnly) || !reserve(task.id, file.size()))
+    {
+        return QByteArray();
+    }
+    return file.read(kMaxReadAheadBytes);
+}
+
+void read_ahead::finish_read(quint64 id, QByteArray data)
+{
+    QMutexLocker locker(&mutex_);
+    auto it = entries_.find(id);
+    if (it != entries_.end())
+    {
+        if (data.isEmpty())
+        {
+            erase_entry(it);
+        }
+        else
+        {
+            it->status = state::ready;
+            it->data = std::move(data);
+        }
+    }
+    read_done_.wakeAll();
+}
+
+void read_ahead::erase_entry(QHash<quint64, entry>::iterator it)
+{
+    held_bytes_ -= it->reserved_bytes;
+    entries_.erase(it);
+}
+
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+void read_ahead::io_loop()
+{
+    constexpr long long kCompletionPollNs = 2'000'000;
+
+    struct read_op
+    {
+        int fd = -1;
+        QByteArray data;
+    };
+
+    io_uring ring{};
+    const bool ring_ready = io_uring_queue_init(kMaxDepth, &ring, 0) == 0;
+    std::unordered_map<quint64, read_op> in_flight;
+
+    const auto complete = [this, &in_flight](quint64 id, int result)
+    {
+        auto it = in_flight.find(id);
+        if (it == in_flight.end())
+        {
+            return;
+        }
+        ::close(it->second.fd);
+        QByteArray data = result == it->second.data.size() ? std::move(it->second.data) : QByteArray();
+        in_flight.erase(it);
+        finish_read(id, std::move(data));
+    };
+
+    while (!stop_)
+    {
+        std::vector<load_task> batch;
+        {
+            QMutexLocker locker(&mutex_);
+            while (!stop_ && pending_.empty() && in_flight.empty())
+            {
+                work_available_.wait(&mutex_);
+            }
+            if (stop_)
+            {
+                break;
+            }
+            while (!pending_.empty() && static_cast<int>(in_flight.size() + batch.size()) < std::max(1, depth()))
+            {
+                batch.push_back(std::move(pending_.front()));
+                pending_.pop_front();
+            }
+        }
+
+        bool submitted = false;
+        for (const auto& task : batch)
+        {
+            if (!begin_read(task))
+            {
+                continue;
+            }
+            if (!ring_ready)
+            {
+                finish_read(task.id, read_file(task));
+                continue;
+            }
+
+            const int fd = ::open(QFile::encodeName(task.path).constData(), O_RDONLY | O_CLOEXEC);
+            struct stat st
+            {
+            };
+            if (fd < 0 || ::fstat(fd, &st) != 0 || !reserve(task.id, st.st_size))
+            {
+                if (fd >= 0)
+                {
+                    ::close(fd);
+                }
+                finish_read(task.id, QByteArray());
+                continue;
+            }
+
+            io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            if (sqe == nullptr)
+            {
+                ::close(fd);
+                finish_read(task.id, QByteArray());
+                continue;
+            }
+
+            read_op& op = in_flight[task.id];
+            op.fd = fd;
+            op.data = QByteArray(static_cast<qsizetype>(st.st_size), Qt::Uninitialized);
+            io_uring_prep_read(sqe, fd, op.data.data(), static_cast<unsigned>(st.st_size), 0);
+            sqe->user_data = task.id;
+            submitted = true;
+        }
+        if (submitted)
+        {
+            io_uring_submit(&ring);
+        }
+
+        if (in_flight.empty())
+        {
+            continue;
+        }
+
+        __kernel_timespec timeout{0, kCompletionPollNs};
+        io_uring_cqe* cqe = nullptr;
+        if (io_uring_wait_cqe_timeout(&ring, &cqe, &timeout) != 0)
+        {
+            continue;
+        }
+
+        unsigned head = 0;
+        unsigned seen = 0;
+        io_uring_for_each_cqe(&ring, head, cqe)
+        {
+            complete(cqe->user_data, cqe->res);
+            ++seen;
+        }
+        io_uring_cq_advance(&ring, seen);
+    }
+
+    while (ring_ready && !in_flight.empty())
+    {
+        io_uring_cqe* cqe = nullptr;
+        if (io_uring_wait_cqe(&ring, &cqe) != 0)
+        {
+            break;
+        }
+        complete(cqe->user_data, cqe->res);
+        io_uring_cqe_seen(&ring, cqe);
+    }
+    if (ring_ready)
+    {
+        io_uring_queue_exit(&ring);
+    }
+}
+#else
+void read_ahead::read_blocking(const load_task& task)
+{
+    if (stop_ || !begin_read(task))
+    {
+        return;
+    }
+    finish_read(task.id, read_file(task));
+}
+#endif
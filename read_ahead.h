@@ -0,0 +1,84 @@
+#ifndef IMAGE_VIEWER_READ_AHEAD_H
+#define IMAGE_VIEWER_READ_AHEAD_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "common_types.h"
+
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+class QThread;
+#else
+#include <QThreadPool>
+#endif
+
+class read_ahead
+{
+   public:
+    using source_filter = std::function<bool(const load_task&)>;
+
+    explicit read_ahead(source_filter needs_source, int depth);
+    ~read_ahead();
+
+    read_ahead(const read_ahead&) = delete;
+    read_ahead& operator=(const read_ahead&) = delete;
+
+    void set_depth(int depth);
+    [[nodiscard]] int depth() const { return depth_.load(std::memory_order_relaxed); }
+    void prefetch(const std::vector<load_task>& tasks);
+    [[nodiscard]] QByteArray take(quint64 id);
+    void discard(const QList<quint64>& ids);
+    void clear();
+
+   private:
+    enum class state
+    {
+        queued,
+        reading,
+        ready
+    };
+
+    struct entry
+    {
+        state status = state::queued;
+        QByteArray data;
+        qint64 reserved_bytes = 0;
+    };
+
+    [[nodiscard]] bool begin_read(const load_task& task);
+    [[nodiscard]] bool reserve(quint64 id, qint64 bytes);
+    [[nodiscard]] QByteArray read_file(const load_task& task);
+    void finish_read(quint64 id, QByteArray data);
+    void erase_entry(QHash<quint64, entry>::iterator it);
+
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+    void io_loop();
+#else
+    void read_blocking(const load_task& task);
+#endif
+
+   private:
+    source_filter needs_source_;
+    std::atomic<int> depth_{0};
+    std::atomic<bool> stop_{false};
+    QMutex mutex_;
+    QWaitCondition read_done_;
+    QHash<quint64, entry> entries_;
+    qint64 held_bytes_ = 0;
+
+#ifdef IMAGEVIEWER_HAVE_LIBURING
+    QWaitCondition work_available_;
+    std::deque<load_task> pending_;
+    QThread* io_thread_ = nullptr;
+#else
+    QThreadPool pool_;
+#endif
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef IMAGE_VIEWER_RESULT_RING_H
+#define IMAGE_VIEWER_RESULT_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+template <typename T>
+class result_ring
+{
+   public:
+    explicit result_ring(size_t capacity)
+    {
+        size_t rounded = 2;
+        while (rounded < capacity)
+        {
+            rounded <<= 1;
+        }
+        mask_ = rounded - 1;
+        slots_ = std::make_unique<slot[]>(rounded);
+        for (size_t i = 0; i < rounded; ++i)
+        {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    result_ring(const result_ring&) = delete;
+    result_ring& operator=(const result_ring&) = delete;
+
+    [[nodiscard]] bool try_push(T&& value)
+    {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            slot& s = slots_[pos & mask_];
+            const size_t sequence = s.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    s.value = std::move(value);
+                    s.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    [[nodiscard]] bool try_pop(T& value)
+    {
+        const size_t pos = head_;
+        slot& s = slots_[pos & mask_];
+        if (s.sequence.load(std::memory_order_acquire) != pos + 1)
+        {
+            return false;
+        }
+        value = std::move(s.value);
+        s.value = T();
+        s.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        head_ = pos + 1;
+        return true;
+    }
+
+   private:
+    struct slot
+    {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    std::unique_ptr<slot[]> slots_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) size_t head_ = 0;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "signature_store.h"
+#include "keyed_record_store.h"
+
+namespace
+{
+constexpr quint32 kStoreMagic = 0x53494753;
+constexpr quint32 kStoreVersion = 1;
+
+keyed_record_store<color_signature>& store()
+{
+    static keyed_record_store<color_signature> s(kStoreMagic, kStoreVersion, "color_signatures.bin");
+    return s;
+}
+}
+
+bool signature_store::find(const QString& path, qint64 modified_time, qint64 file_size, color_signature& signature)
+{
+    return store().find(path, modified_time, file_size, signature);
+}
+
+void signature_store::insert(const QString& path, qint64 modified_time, qint64 file_size, const color_signature& signature)
+{
+    if (signature.valid)
+    {
+        store().insert(path, modified_time, file_size, signature);
+    }
+}
+
+void signature_store::prune() { store().prune(); }
+
+void signature_store::clear() { store().clear(); }
+
+void signature_store::flush() { store().flush(); }
@@ -0,0 +1,17 @@
+#ifndef IMAGE_VIEWER_SIGNATURE_STORE_H
+#define IMAGE_VIEWER_SIGNATURE_STORE_H
+
+#include <QString>
+#include "color_signature.h"
+
+class signature_store
+{
+   public:
+    static bool find(const QString& path, qint64 modified_time, qint64 file_size, color_signature& signature);
+    static void insert(const QString& path, qint64 modified_time, qint64 file_size, const color_signature& signature);
+    static void prune();
+    static void clear();
+    static void flush();
+};
+
+#endif
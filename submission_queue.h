@@ -0,0 +1,72 @@
+#ifndef IMAGE_VIEWER_SUBMISSION_QUEUE_H
+#define IMAGE_VIEWER_SUBMISSION_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+template <typename T>
+class submission_queue
+{
+   public:
+    submission_queue() = default;
+    submission_queue(const submission_queue&) = delete;
+    submission_queue& operator=(const submission_queue&) = delete;
+
+    ~submission_queue()
+    {
+        node* n = head_.exchange(nullptr);
+        while (n != nullptr)
+        {
+            node* next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+    void push(T&& value)
+    {
+        auto* n = new node{std::move(value), head_.load(std::memory_order_relaxed)};
+        while (!head_.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    template <typename Fn>
+    bool consume_all(Fn&& fn)
+    {
+        node* n = head_.exchange(nullptr, std::memory_order_acquire);
+        if (n == nullptr)
+        {
+            return false;
+        }
+
+        node* ordered = nullptr;
+        while (n != nullptr)
+        {
+            node* next = n->next;
+            n->next = ordered;
+            ordered = n;
+            n = next;
+        }
+
+        while (ordered != nullptr)
+        {
+            node* next = ordered->next;
+            fn(std::move(ordered->value));
+            delete ordered;
+            ordered = next;
+        }
+        return true;
+    }
+
+   private:
+    struct node
+    {
+        T value;
+        node* next;
+    };
+
+    std::atomic<node*> head_{nullptr};
+};
+
+#endif
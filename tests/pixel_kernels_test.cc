@@ -0,0 +1,242 @@
+#include <QImage>
+#include <QRandomGenerator>
+#include <QTest>
+#include <QTransform>
+#include <array>
+#include <cstring>
+#include "area_scaler.h"
+#include "pixel_kernels.h"
+
+namespace
+{
+constexpr std::array<cpu_features::simd_level, 3> kSimdLevels = {
+    cpu_features::simd_level::sse41, cpu_features::simd_level::avx2, cpu_features::simd_level::neon};
+constexpr std::array<QSize, 9> kOddSizes = {
+    QSize(1, 1), QSize(3, 5), QSize(7, 9), QSize(15, 1), QSize(17, 13), QSize(33, 31), QSize(65, 3), QSize(127, 129), QSize(255, 7)};
+constexpr quint32 kSeed = 0x1d2c3b4a;
+
+QImage random_image(const QSize& size, QImage::Format format, QRandomGenerator& rng)
+{
+    QImage image(size, format);
+    for (int y = 0; y < image.height(); ++y)
+    {
+        uchar* row = image.scanLine(y);
+        for (qsizetype i = 0; i < image.bytesPerLine(); ++i)
+        {
+            row[i] = static_cast<uchar>(rng.generate());
+        }
+    }
+    return image;
+}
+
+// Mixes fully transparent, opaque and partial alpha so the premultiply edge cases land in every vector lane.
+QImage random_argb(const QSize& size, QRandomGenerator& rng)
+{
+    QImage image = random_image(size, QImage::Format_ARGB32, rng);
+    for (int y = 0; y < image.height(); ++y)
+    {
+        auto* row = reinterpret_cast<quint32*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+        {
+            switch (rng.bounded(4))
+            {
+                case 0:
+                    row[x] &= 0x00ffffffu;
+                    break;
+                case 1:
+                    row[x] |= 0xff000000u;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    return image;
+}
+
+QImage rotated(const QImage& image, qreal degrees) { return image.transformed(QTransform().rotate(degrees)); }
+
+// What each EXIF orientation means, spelled out with QImage's own operations.
+QImage qt_oriented(const QImage& image, int orientation)
+{
+    switch (orientation)
+    {
+        case 2:
+            return image.mirrored(true, false);
+        case 3:
+            return rotated(image, 180);
+        case 4:
+            return image.mirrored(false, true);
+        case 5:
+            return rotated(image, 90).mirrored(true, false);
+        case 6:
+            return rotated(image, 90);
+        case 7:
+            return rotated(image, 90).mirrored(false, true);
+        case 8:
+            return rotated(image, 270);
+        default:
+            return image;
+    }
+}
+
+bool same_pixels(const QImage& left, const QImage& right)
+{
+    if (left.size() != right.size() || left.format() != right.format())
+    {
+        return false;
+    }
+    const auto row_bytes = static_cast<size_t>(left.width()) * static_cast<size_t>(left.depth() / 8);
+    for (int y = 0; y < left.height(); ++y)
+    {
+        if (std::memcmp(left.constScanLine(y), right.constScanLine(y), row_bytes) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+class pixel_kernels_test : public QObject
+{
+    Q_OBJECT
+
+   private slots:
+    void premultiply_matches_scalar();
+    void byte_formats_match_scalar();
+    void transforms_match_scalar();
+    void exif_orientations_match_qt();
+    void area_scaler_matches_scalar();
+};
+
+void pixel_kernels_test::premultiply_matches_scalar()
+{
+    QRandomGenerator rng(kSeed);
+    for (const QSize& size : kOddSizes)
+    {
+        const QImage source = random_argb(size, rng);
+        const QImage expected = pixel_kernels::to_premultiplied(source.copy(), cpu_features::simd_level::scalar);
+        QVERIFY(same_pixels(expected, source.convertToFormat(QImage::Format_ARGB32_Premultiplied)));
+        for (const cpu_features::simd_level level : kSimdLevels)
+        {
+            if (!cpu_features::supports(level))
+            {
+                continue;
+            }
+            QVERIFY2(same_pixels(pixel_kernels::to_premultiplied(source.copy(), level), expected), cpu_features::simd_level_name(level));
+        }
+    }
+}
+
+void pixel_kernels_test::byte_formats_match_scalar()
+{
+    QRandomGenerator rng(kSeed);
+    for (const QSize& size : kOddSizes)
+    {
+        for (const QImage::Format format : {QImage::Format_RGB888, QImage::Format_Grayscale8})
+        {
+            const QImage source = random_image(size, format, rng);
+            const QImage expected = pixel_kernels::to_premultiplied(source, cpu_features::simd_level::scalar);
+            QVERIFY(same_pixels(expected, source.convertToFormat(QImage::Format_ARGB32_Premultiplied)));
+            for (const cpu_features::simd_level level : kSimdLevels)
+            {
+                if (!cpu_features::supports(level))
+                {
+                    continue;
+                }
+                QVERIFY2(same_pixels(pixel_kernels::to_premultiplied(source, level), expected), cpu_features::simd_level_name(level));
+            }
+        }
+    }
+}
+
+void pixel_kernels_test::transforms_match_scalar()
+{
+    constexpr std::array<QImageIOHandler::Transformation, 7> kTransformations = {QImageIOHandler::TransformationMirror,
+                                                                                 QImageIOHandler::TransformationFlip,
+                                                                                 QImageIOHandler::TransformationRotate180,
+                                                                                 QImageIOHandler::TransformationRotate90,
+                                                                                 QImageIOHandler::TransformationMirrorAndRotate90,
+                                                                                 QImageIOHandler::TransformationFlipAndRotate90,
+                                                                                 QImageIOHandler::TransformationRotate270};
+
+    QRandomGenerator rng(kSeed);
+    for (const QSize& size : kOddSizes)
+    {
+        const QImage source = random_image(size, QImage::Format_ARGB32_Premultiplied, rng);
+        for (const QImageIOHandler::Transformation transformation : kTransformations)
+        {
+            const QImage expected = pixel_kernels::transformed(source, transformation, cpu_features::simd_level::scalar);
+            const bool rotated = QImageIOHandler::Transformations(transformation).testFlag(QImageIOHandler::TransformationRotate90);
+            QCOMPARE(expected.size(), rotated ? size.transposed() : size);
+            for (const cpu_features::simd_level level : kSimdLevels)
+            {
+                if (!cpu_features::supports(level))
+                {
+                    continue;
+                }
+                QVERIFY2(same_pixels(pixel_kernels::transformed(source, transformation, level), expected), cpu_features::simd_level_name(level));
+            }
+        }
+    }
+}
+
+void pixel_kernels_test::exif_orientations_match_qt()
+{
+    QRandomGenerator rng(kSeed);
+    for (const QSize& size : kOddSizes)
+    {
+        const QImage source = random_image(size, QImage::Format_ARGB32_Premultiplied, rng);
+        for (int orientation = 1; orientation <= 8; ++orientation)
+        {
+            const QImage expected = qt_oriented(source, orientation);
+            const QImageIOHandler::Transformations transformation = pixel_kernels::exif_transformation(orientation);
+            QVERIFY(same_pixels(pixel_kernels::transformed(source, transformation, cpu_features::simd_level::scalar), expected));
+            for (const cpu_features::simd_level level : kSimdLevels)
+            {
+                if (!cpu_features::supports(level))
+                {
+                    continue;
+                }
+                QVERIFY2(same_pixels(pixel_kernels::transformed(source, transformation, level), expected), cpu_features::simd_level_name(level));
+            }
+        }
+    }
+}
+
+void pixel_kernels_test::area_scaler_matches_scalar()
+{
+    constexpr std::array<QSize, 4> kBounds = {QSize(1, 1), QSize(5, 5), QSize(31, 17), QSize(100, 100)};
+
+    QRandomGenerator rng(kSeed);
+    for (const QSize& size : kOddSizes)
+    {
+        for (const QImage::Format format : {QImage::Format_RGB32, QImage::Format_ARGB32_Premultiplied})
+        {
+            const QImage source = format == QImage::Format_RGB32 ? random_image(size, format, rng)
+                                                                  : pixel_kernels::to_premultiplied(random_argb(size, rng));
+            for (const QSize& bound : kBounds)
+            {
+                const QSize target = size.scaled(bound, Qt::KeepAspectRatio);
+                if (target.isEmpty() || target.width() > size.width() || target.height() > size.height())
+                {
+                    continue;
+                }
+                const QImage expected = area_scaler::scaled(source, bound, cpu_features::simd_level::scalar);
+                QCOMPARE(expected.size(), target);
+                for (const cpu_features::simd_level level : kSimdLevels)
+                {
+                    if (!cpu_features::supports(level))
+                    {
+                        continue;
+                    }
+                    QVERIFY2(same_pixels(area_scaler::scaled(source, bound, level), expected), cpu_features::simd_level_name(level));
+                }
+            }
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(pixel_kernels_test)
+#include "pixel_kernels_test.moc"
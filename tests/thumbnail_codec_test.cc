@@ -0,0 +1,109 @@
+#include <QRandomGenerator>
+#include <QTest>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "thumbnail_codec.h"
+
+namespace
+{
+constexpr quint32 kSeed = 0x51f00d;
+constexpr int kRowPadding = 12;
+
+enum class pattern
+{
+    noise,
+    flat,
+    gradient,
+    stripes
+};
+
+// Rows carry kRowPadding bytes of garbage past the pixels, so a codec that ignores bytes_per_line shows up as a mismatch.
+std::vector<uchar> make_pixels(int width, int height, pattern kind, QRandomGenerator& rng)
+{
+    const qsizetype bytes_per_line = static_cast<qsizetype>(width) * 4 + kRowPadding;
+    std::vector<uchar> pixels(static_cast<size_t>(bytes_per_line * height));
+    for (uchar& byte : pixels)
+    {
+        byte = static_cast<uchar>(rng.generate());
+    }
+
+    for (int y = 0; y < height; ++y)
+    {
+        auto* row = reinterpret_cast<quint32*>(pixels.data() + y * bytes_per_line);
+        for (int x = 0; x < width; ++x)
+        {
+            switch (kind)
+            {
+                case pattern::noise:
+                    break;
+                case pattern::flat:
+                    row[x] = 0xff336699u;
+                    break;
+                case pattern::gradient:
+                    row[x] = 0xff000000u | (static_cast<quint32>(x & 0xff) << 16) | (static_cast<quint32>(y & 0xff) << 8) |
+                             static_cast<quint32>((x + y) & 0xff);
+                    break;
+                case pattern::stripes:
+                    row[x] = (x / 3) % 2 == 0 ? 0x80ff0000u : 0x00000000u;
+                    break;
+            }
+        }
+    }
+    return pixels;
+}
+}
+
+class thumbnail_codec_test : public QObject
+{
+    Q_OBJECT
+
+   private slots:
+    void round_trip();
+    void rejects_truncated_data();
+};
+
+void thumbnail_codec_test::round_trip()
+{
+    QRandomGenerator rng(kSeed);
+    for (const auto& [width, height] : {std::pair{1, 1}, std::pair{3, 7}, std::pair{61, 1}, std::pair{63, 65}, std::pair{257, 9}})
+    {
+        for (const pattern kind : {pattern::noise, pattern::flat, pattern::gradient, pattern::stripes})
+        {
+            const qsizetype bytes_per_line = static_cast<qsizetype>(width) * 4 + kRowPadding;
+            const std::vector<uchar> pixels = make_pixels(width, height, kind, rng);
+
+            std::vector<uchar> encoded(static_cast<size_t>(thumbnail_codec::max_encoded_size(width, height)));
+            const qsizetype encoded_bytes = thumbnail_codec::encode(pixels.data(), width, height, bytes_per_line, encoded.data());
+            QVERIFY(encoded_bytes > 0);
+            QVERIFY(encoded_bytes <= thumbnail_codec::max_encoded_size(width, height));
+
+            std::vector<uchar> decoded(pixels.size(), 0);
+            QVERIFY(thumbnail_codec::decode(encoded.data(), encoded_bytes, decoded.data(), width, height, bytes_per_line));
+            for (int y = 0; y < height; ++y)
+            {
+                const qsizetype offset = y * bytes_per_line;
+                QVERIFY(std::memcmp(decoded.data() + offset, pixels.data() + offset, static_cast<size_t>(width) * 4) == 0);
+            }
+        }
+    }
+}
+
+void thumbnail_codec_test::rejects_truncated_data()
+{
+    constexpr int kWidth = 31;
+    constexpr int kHeight = 17;
+    constexpr qsizetype kBytesPerLine = kWidth * 4 + kRowPadding;
+
+    QRandomGenerator rng(kSeed);
+    const std::vector<uchar> pixels = make_pixels(kWidth, kHeight, pattern::noise, rng);
+    std::vector<uchar> encoded(static_cast<size_t>(thumbnail_codec::max_encoded_size(kWidth, kHeight)));
+    const qsizetype encoded_bytes = thumbnail_codec::encode(pixels.data(), kWidth, kHeight, kBytesPerLine, encoded.data());
+
+    std::vector<uchar> decoded(pixels.size());
+    QVERIFY(!thumbnail_codec::decode(encoded.data(), encoded_bytes / 2, decoded.data(), kWidth, kHeight, kBytesPerLine));
+    QVERIFY(!thumbnail_codec::decode(encoded.data(), 0, decoded.data(), kWidth, kHeight, kBytesPerLine));
+}
+
+QTEST_APPLESS_MAIN(thumbnail_codec_test)
+#include "thumbnail_codec_test.moc"
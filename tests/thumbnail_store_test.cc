@@ -0,0 +1,239 @@
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTest>
+#include <array>
+#include <cstring>
+#include <vector>
+#include "thumbnail_store.h"
+
+namespace
+{
+constexpr qint64 kStoreBytes = 64LL * 1024 * 1024;
+constexpr quint32 kSeed = 0x7b0e;
+constexpr QSize kEvictionSize(256, 256);
+constexpr qint64 kEvictionRecordBytes = 256LL * 256 * 4 + 64;
+constexpr std::array<QSize, 4> kOddSizes = {QSize(1, 1), QSize(3, 5), QSize(97, 61), QSize(255, 17)};
+
+QImage noise_image(const QSize& size, QImage::Format format, QRandomGenerator& rng)
+{
+    QImage image(size, format);
+    for (int y = 0; y < image.height(); ++y)
+    {
+        auto* row = reinterpret_cast<quint32*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+        {
+            row[x] = rng.generate() | (format == QImage::Format_RGB32 ? 0xff000000u : 0u);
+        }
+    }
+    return image;
+}
+
+// Smooth enough that the QOI codec wins over raw storage.
+QImage gradient_image(const QSize& size)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < image.height(); ++y)
+    {
+        auto* row = reinterpret_cast<quint32*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+        {
+            row[x] = 0xff000000u | (static_cast<quint32>(y & 0xff) << 8) | static_cast<quint32>((x / 4) & 0xff);
+        }
+    }
+    return image;
+}
+
+bool same_pixels(const QImage& left, const QImage& right)
+{
+    if (left.size() != right.size() || left.format() != right.format())
+    {
+        return false;
+    }
+    for (int y = 0; y < left.height(); ++y)
+    {
+        if (std::memcmp(left.constScanLine(y), right.constScanLine(y), static_cast<size_t>(left.width()) * 4) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+class thumbnail_store_test : public QObject
+{
+    Q_OBJECT
+
+   private slots:
+    void round_trip_raw();
+    void round_trip_qoi();
+    void survives_reopen();
+    void replaces_existing_key();
+    void drops_corrupted_record();
+    void evicts_least_recently_used();
+    void compaction_shrinks_pack();
+};
+
+void thumbnail_store_test::round_trip_raw()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    thumbnail_store store(dir.path(), kStoreBytes, thumbnail_store::codec::raw);
+
+    QRandomGenerator rng(kSeed);
+    std::vector<QImage> images;
+    for (const QSize& size : kOddSizes)
+    {
+        for (const QImage::Format format : {QImage::Format_RGB32, QImage::Format_ARGB32_Premultiplied})
+        {
+            images.push_back(noise_image(size, format, rng));
+            store.insert(images.size(), images.back());
+        }
+    }
+
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        QVERIFY(store.contains(i + 1));
+        QVERIFY(same_pixels(store.find(i + 1), images[i]));
+    }
+    QVERIFY(!store.contains(images.size() + 1));
+    QVERIFY(store.find(images.size() + 1).isNull());
+}
+
+void thumbnail_store_test::round_trip_qoi()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    thumbnail_store store(dir.path(), kStoreBytes, thumbnail_store::codec::qoi);
+
+    QRandomGenerator rng(kSeed);
+    for (const QSize& size : kOddSizes)
+    {
+        const QImage smooth = gradient_image(size);
+        const QImage noisy = noise_image(size, QImage::Format_ARGB32_Premultiplied, rng);
+        store.insert(1, smooth);
+        QVERIFY(same_pixels(store.find(1), smooth));
+        store.insert(2, noisy);
+        QVERIFY(same_pixels(store.find(2), noisy));
+    }
+}
+
+void thumbnail_store_test::survives_reopen()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QRandomGenerator rng(kSeed);
+    const QImage raw = noise_image(QSize(33, 21), QImage::Format_RGB32, rng);
+    const QImage compressed = gradient_image(QSize(129, 67));
+    {
+        thumbnail_store store(dir.path(), kStoreBytes);
+        store.insert(7, raw);
+        store.insert(9, compressed);
+        store.flush();
+    }
+
+    thumbnail_store reopened(dir.path(), kStoreBytes);
+    QVERIFY(same_pixels(reopened.find(7), raw));
+    QVERIFY(same_pixels(reopened.find(9), compressed));
+}
+
+void thumbnail_store_test::replaces_existing_key()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    thumbnail_store store(dir.path(), kStoreBytes);
+
+    QRandomGenerator rng(kSeed);
+    const QImage first = noise_image(QSize(17, 9), QImage::Format_RGB32, rng);
+    const QImage second = noise_image(QSize(9, 17), QImage::Format_ARGB32_Premultiplied, rng);
+    store.insert(3, first);
+    store.insert(3, second);
+    QVERIFY(same_pixels(store.find(3), second));
+}
+
+void thumbnail_store_test::drops_corrupted_record()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QRandomGenerator rng(kSeed);
+    {
+        thumbnail_store store(dir.path(), kStoreBytes, thumbnail_store::codec::raw);
+        store.insert(5, noise_image(QSize(15, 15), QImage::Format_RGB32, rng));
+        store.flush();
+    }
+
+    QFile pack(dir.filePath("thumbnails.pack"));
+    QVERIFY(pack.open(QIODevice::ReadWrite));
+    const QByteArray garbage(16, '\x5a');
+    QCOMPARE(pack.write(garbage), static_cast<qint64>(garbage.size()));
+    pack.close();
+
+    thumbnail_store reopened(dir.path(), kStoreBytes, thumbnail_store::codec::raw);
+    QVERIFY(reopened.find(5).isNull());
+    QVERIFY(!reopened.contains(5));
+}
+
+void thumbnail_store_test::evicts_least_recently_used()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    thumbnail_store store(dir.path(), 4 * kEvictionRecordBytes, thumbnail_store::codec::raw);
+
+    QRandomGenerator rng(kSeed);
+    const QImage image = noise_image(kEvictionSize, QImage::Format_RGB32, rng);
+    for (quint64 key = 1; key <= 4; ++key)
+    {
+        store.insert(key, image);
+    }
+    QVERIFY(!store.find(1).isNull());
+    store.insert(5, image);
+    QVERIFY(!store.contains(2));
+    QVERIFY(!store.find(3).isNull());
+    store.insert(6, image);
+    QVERIFY(!store.contains(4));
+
+    for (const quint64 key : {1, 3, 5, 6})
+    {
+        QVERIFY(same_pixels(store.find(key), image));
+    }
+}
+
+void thumbnail_store_test::compaction_shrinks_pack()
+{
+    constexpr int kLiveRecords = 4;
+    constexpr int kInsertedRecords = 160;
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    thumbnail_store store(dir.path(), kLiveRecords * kEvictionRecordBytes, thumbnail_store::codec::raw);
+
+    QRandomGenerator rng(kSeed);
+    const QImage image = noise_image(kEvictionSize, QImage::Format_RGB32, rng);
+    for (quint64 key = 1; key <= kInsertedRecords; ++key)
+    {
+        store.insert(key, image);
+    }
+
+    const QString pack_path = dir.filePath("thumbnails.pack");
+    QCOMPARE(QFile(pack_path).size(), kInsertedRecords * kEvictionRecordBytes);
+    QVERIFY(store.compaction_pending());
+
+    store.compact();
+    QVERIFY(!store.compaction_pending());
+    QCOMPARE(QFile(pack_path).size(), kLiveRecords * kEvictionRecordBytes);
+    for (quint64 key = kInsertedRecords - kLiveRecords + 1; key <= kInsertedRecords; ++key)
+    {
+        QVERIFY(same_pixels(store.find(key), image));
+    }
+    QVERIFY(!store.contains(kInsertedRecords - kLiveRecords));
+
+    store.flush();
+    thumbnail_store reopened(dir.path(), kLiveRecords * kEvictionRecordBytes, thumbnail_store::codec::raw);
+    QVERIFY(same_pixels(reopened.find(kInsertedRecords), image));
+}
+
+QTEST_APPLESS_MAIN(thumbnail_store_test)
+#include "thumbnail_store_test.moc"
@@ -0,0 +1,162 @@
+#include <QElapsedTimer>
+#include "thumbnail_cache.h"
+
+thumbnail_cache::thumbnail_cache(qint64 max_bytes) : max_bytes_(max_bytes) {}
+
+int thumbnail_cache::shard_index(quint64 key)
+{
+    constexpr quint64 kMix = 0x9E3779B97F4A7C15ULL;
+    return static_cast<int>(((key ^ (key >> 32)) * kMix) >> 60) % kShardCount;
+}
+
+void thumbnail_cache::lock(shard& s)
+{
+    if (s.mutex.tryLock())
+    {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    s.mutex.lock();
+    s.lock_wait_ns.fetch_add(static_cast<quint64>(timer.nsecsElapsed()), std::memory_order_relaxed);
+}
+
+bool thumbnail_cache::find(quint64 key, QImage& image)
+{
+    shard& s = shards_[shard_index(key)];
+    lock(s);
+    auto it = s.entries.find(key);
+    if (it == s.entries.end())
+    {
+        s.mutex.unlock();
+        s.misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    s.lru.splice(s.lru.begin(), s.lru, it->lru_it);
+    image = it->image;
+    s.mutex.unlock();
+    s.hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool thumbnail_cache::contains(quint64 key) const
+{
+    const shard& s = shards_[shard_index(key)];
+    QMutexLocker locker(&s.mutex);
+    return s.entries.contains(key);
+}
+
+void thumbnail_cache::insert(quint64 key, const QImage& image)
+{
+    const qint64 cost = image.sizeInBytes();
+    if (image.isNull() || cost > max_bytes() / kShardCount)
+    {
+        return;
+    }
+
+    shard& s = shards_[shard_index(key)];
+    lock(s);
+    auto it = s.entries.find(key);
+    if (it != s.entries.end())
+    {
+        s.bytes.fetch_sub(it->cost, std::memory_order_relaxed);
+        total_bytes_.fetch_sub(it->cost, std::memory_order_relaxed);
+        s.lru.erase(it->lru_it);
+        s.entries.erase(it);
+    }
+
+    s.lru.push_front(key);
+    s.entries.insert(key, entry{image, cost, s.lru.begin()});
+    s.bytes.fetch_add(cost, std::memory_order_relaxed);
+    total_bytes_.fetch_add(cost, std::memory_order_relaxed);
+    evicted_list evicted;
+    evict_from(s, &key, evicted);
+    s.mutex.unlock();
+
+    evict_others(&s, evicted);
+    hand_off(evicted);
+}
+
+void thumbnail_cache::set_max_bytes(qint64 max_bytes)
+{
+    max_bytes_.store(max_bytes, std::memory_order_relaxed);
+    // A shrink means memory is short: drop victims instead of re-encoding them into the sink.
+    evicted_list dropped;
+    evict_others(nullptr, dropped);
+}
+
+void thumbnail_cache::evict_others(const shard* skip, evicted_list& evicted)
+{
+    for (int attempt = 0; attempt < kShardCount && total_bytes() > max_bytes(); ++attempt)
+    {
+        shard& victim = shards_[next_victim_.fetch_add(1, std::memory_order_relaxed) % kShardCount];
+        if (&victim == skip)
+        {
+            continue;
+        }
+        lock(victim);
+        evict_from(victim, nullptr, evicted);
+        victim.mutex.unlock();
+    }
+}
+
+void thumbnail_cache::evict_from(shard& s, const quint64* keep_key, evicted_list& evicted)
+{
+    while (total_bytes() > max_bytes() && !s.lru.empty())
+    {
+        const quint64 victim_key = s.lru.back();
+        if (keep_key != nullptr && victim_key == *keep_key)
+        {
+            break;
+        }
+
+        auto it = s.entries.find(victim_key);
+        s.bytes.fetch_sub(it->cost, std::memory_order_relaxed);
+        total_bytes_.fetch_sub(it->cost, std::memory_order_relaxed);
+        s.lru.pop_back();
+        if (eviction_sink_)
+        {
+            evicted.emplace_back(victim_key, std::move(it->image));
+        }
+        s.entries.erase(it);
+    }
+}
+
+void thumbnail_cache::hand_off(evicted_list& evicted) const
+{
+    for (auto& [key, image] : evicted)
+    {
+        eviction_sink_(key, image);
+    }
+    evicted.clear();
+}
+
+void thumbnail_cache::clear()
+{
+    for (shard& s : shards_)
+    {
+        lock(s);
+        total_bytes_.fetch_sub(s.bytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        s.entries.clear();
+        s.lru.clear();
+        s.mutex.unlock();
+    }
+}
+
+std::vector<thumbnail_cache::shard_stats> thumbnail_cache::stats() const
+{
+    std::vector<shard_stats> result;
+    result.reserve(kShardCount);
+    for (const shard& s : shards_)
+    {
+        shard_stats stat;
+        stat.hits = s.hits.load(std::memory_order_relaxed);
+        stat.misses = s.misses.load(std::memory_order_relaxed);
+        stat.lock_wait_ns = s.lock_wait_ns.load(std::memory_order_relaxed);
+        stat.bytes = s.bytes.load(std::memory_order_relaxed);
+        result.push_back(stat);
+    }
+    return result;
+}
@@ -0,0 +1,78 @@
+#ifndef IMAGE_VIEWER_THUMBNAIL_CACHE_H
+#define IMAGE_VIEWER_THUMBNAIL_CACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <vector>
+
+class thumbnail_cache
+{
+   public:
+    using eviction_sink = std::function<void(quint64 key, const QImage& image)>;
+
+    struct shard_stats
+    {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 lock_wait_ns = 0;
+        qint64 bytes = 0;
+    };
+
+    explicit thumbnail_cache(qint64 max_bytes);
+
+    thumbnail_cache(const thumbnail_cache&) = delete;
+    thumbnail_cache& operator=(const thumbnail_cache&) = delete;
+
+    [[nodiscard]] bool find(quint64 key, QImage& image);
+    [[nodiscard]] bool contains(quint64 key) const;
+    void insert(quint64 key, const QImage& image);
+    void clear();
+    void set_eviction_sink(eviction_sink sink) { eviction_sink_ = std::move(sink); }
+    void set_max_bytes(qint64 max_bytes);
+    [[nodiscard]] qint64 max_bytes() const { return max_bytes_.load(std::memory_order_relaxed); }
+    [[nodiscard]] qint64 total_bytes() const { return total_bytes_.load(std::memory_order_relaxed); }
+    [[nodiscard]] std::vector<shard_stats> stats() const;
+
+   private:
+    static constexpr int kShardCount = 16;
+
+    struct entry
+    {
+        QImage image;
+        qint64 cost = 0;
+        std::list<quint64>::iterator lru_it;
+    };
+
+    struct shard
+    {
+        mutable QMutex mutex;
+        QHash<quint64, entry> entries;
+        std::list<quint64> lru;
+        std::atomic<qint64> bytes{0};
+        std::atomic<quint64> hits{0};
+        std::atomic<quint64> misses{0};
+        std::atomic<quint64> lock_wait_ns{0};
+    };
+
+    [[nodiscard]] static int shard_index(quint64 key);
+    static void lock(shard& s);
+    using evicted_list = std::vector<std::pair<quint64, QImage>>;
+
+    void evict_from(shard& s, const quint64* keep_key, evicted_list& evicted);
+    void evict_others(const shard* skip, evicted_list& evicted);
+    void hand_off(evicted_list& evicted) const;
+
+   private:
+    std::atomic<qint64> max_bytes_{0};
+    std::atomic<qint64> total_bytes_{0};
+    std::atomic<int> next_victim_{0};
+    std::array<shard, kShardCount> shards_;
+    eviction_sink eviction_sink_;
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include <array>
+#include <cstring>
+#include "thumbnail_codec.h"
+
+namespace
+{
+constexpr uchar kOpIndex = 0x00;
+constexpr uchar kOpDiff = 0x40;
+constexpr uchar kOpLuma = 0x80;
+constexpr uchar kOpRun = 0xc0;
+constexpr uchar kOpRgb = 0xfe;
+constexpr uchar kOpRgba = 0xff;
+constexpr uchar kOpMask = 0xc0;
+constexpr int kMaxRun = 62;
+
+struct pixel
+{
+    std::array<uchar, 4> c{0, 0, 0, 255};
+
+    bool operator==(const pixel& other) const { return c == other.c; }
+    bool operator!=(const pixel& other) const { return c != other.c; }
+};
+
+int hash_pixel(const pixel& p) { return (p.c[0] * 3 + p.c[1] * 5 + p.c[2] * 7 + p.c[3] * 11) % 64; }
+
+int delta(uchar current, uchar previous) { return static_cast<signed char>(static_cast<uchar>(current - previous)); }
+}
+
+namespace thumbnail_codec
+{
+qsizetype max_encoded_size(int width, int height) { return static_cast<qsizetype>(width) * height * 5; }
+
+qsizetype encode(const uchar* pixels, int width, int height, qsizetype bytes_per_line, uchar* out)
+{
+    std::array<pixel, 64> index{};
+    for (pixel& p : index)
+    {
+        p.c = {0, 0, 0, 0};
+    }
+
+    pixel prev;
+    int run = 0;
+    qsizetype n = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        const uchar* row = pixels + (static_cast<qsizetype>(y) * bytes_per_line);
+        for (int x = 0; x < width; ++x)
+        {
+            pixel px;
+            std::memcpy(px.c.data(), row + (static_cast<qsizetype>(x) * 4), 4);
+
+            if (px == prev)
+            {
+                ++run;
+                if (run == kMaxRun)
+                {
+                    out[n++] = static_cast<uchar>(kOpRun | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                out[n++] = static_cast<uchar>(kOpRun | (run - 1));
+                run = 0;
+            }
+
+            const int slot = hash_pixel(px);
+            if (index[slot] == px)
+            {
+                out[n++] = static_cast<uchar>(kOpIndex | slot);
+            }
+            else
+            {
+                index[slot] = px;
+
+                if (px.c[3] == prev.c[3])
+                {
+                    const int d0 = delta(px.c[0], prev.c[0]);
+                    const int d1 = delta(px.c[1], prev.c[1]);
+                    const int d2 = delta(px.c[2], prev.c[2]);
+                    const int d0_d1 = d0 - d1;
+                    const int d2_d1 = d2 - d1;
+
+                    if (d0 >= -2 && d0 <= 1 && d1 >= -2 && d1 <= 1 && d2 >= -2 && d2 <= 1)
+                    {
+                        out[n++] = static_cast<uchar>(kOpDiff | ((d0 + 2) << 4) | ((d1 + 2) << 2) | (d2 + 2));
+                    }
+                    else if (d1 >= -32 && d1 <= 31 && d0_d1 >= -8 && d0_d1 <= 7 && d2_d1 >= -8 && d2_d1 <= 7)
+                    {
+                        out[n++] = static_cast<uchar>(kOpLuma | (d1 + 32));
+                        out[n++] = static_cast<uchar>(((d0_d1 + 8) << 4) | (d2_d1 + 8));
+                    }
+                    else
+                    {
+                        out[n++] = kOpRgb;
+                        out[n++] = px.c[0];
+                        out[n++] = px.c[1];
+                        out[n++] = px.c[2];
+                    }
+                }
+                else
+                {
+                    out[n++] = kOpRgba;
+                    out[n++] = px.c[0];
+                    out[n++] = px.c[1];
+                    out[n++] = px.c[2];
+                    out[n++] = px.c[3];
+                }
+            }
+
+            prev = px;
+        }
+    }
+
+    if (run > 0)
+    {
+        out[n++] = static_cast<uchar>(kOpRun | (run - 1));
+    }
+
+    return n;
+}
+
+bool decode(const uchar* data, qsizetype size, uchar* pixels, int width, int height, qsizetype bytes_per_line)
+{
+    std::array<pixel, 64> index{};
+    for (pixel& p : index)
+    {
+        p.c = {0, 0, 0, 0};
+    }
+
+    pixel px;
+    int run = 0;
+    qsizetype p = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        uchar* row = pixels + (static_cast<qsizetype>(y) * bytes_per_line);
+        for (int x = 0; x < width; ++x)
+        {
+            if (run > 0)
+            {
+                --run;
+            }
+            else
+            {
+                if (p >= size)
+                {
+                    return false;
+                }
+
+                const uchar op = data[p++];
+                if (op == kOpRgb)
+                {
+                    if (size - p < 3)
+                    {
+                        return false;
+                    }
+                    px.c[0] = data[p++];
+                    px.c[1] = data[p++];
+                    px.c[2] = data[p++];
+                }
+                else if (op == kOpRgba)
+                {
+                    if (size - p < 4)
+                    {
+                        return false;
+                    }
+                    px.c[0] = data[p++];
+                    px.c[1] = data[p++];
+                    px.c[2] = data[p++];
+                    px.c[3] = data[p++];
+                }
+                else if ((op & kOpMask) == kOpIndex)
+                {
+                    px = index[op];
+                }
+                else if ((op & kOpMask) == kOpDiff)
+                {
+                    px.c[0] = static_cast<uchar>(px.c[0] + ((op >> 4) & 0x03) - 2);
+                    px.c[1] = static_cast<uchar>(px.c[1] + ((op >> 2) & 0x03) - 2);
+                    px.c[2] = static_cast<uchar>(px.c[2] + (op & 0x03) - 2);
+                }
+                else if ((op & kOpMask) == kOpLuma)
+                {
+                    if (p >= size)
+                    {
+                        return false;
+                    }
+                    const uchar next = data[p++];
+                    const int d1 = (op & 0x3f) - 32;
+                    px.c[0] = static_cast<uchar>(px.c[0] + d1 - 8 + ((next >> 4) & 0x0f));
+                    px.c[1] = static_cast<uchar>(px.c[1] + d1);
+                    px.c[2] = static_cast<uchar>(px.c[2] + d1 - 8 + (next & 0x0f));
+                }
+                else
+                {
+                    run = op & 0x3f;
+                }
+
+                index[hash_pixel(px)] = px;
+            }
+
+            std::memcpy(row + (static_cast<qsizetype>(x) * 4), px.c.data(), 4);
+        }
+    }
+
+    return p == size;
+}
+}
@@ -0,0 +1,13 @@
+#ifndef IMAGE_VIEWER_THUMBNAIL_CODEC_H
+#define IMAGE_VIEWER_THUMBNAIL_CODEC_H
+
+#include <QtGlobal>
+
+namespace thumbnail_codec
+{
+[[nodiscard]] qsizetype max_encoded_size(int width, int height);
+[[nodiscard]] qsizetype encode(const uchar* pixels, int width, int height, qsizetype bytes_per_line, uchar* out);
+[[nodiscard]] bool decode(const uchar* data, qsizetype size, uchar* pixels, int width, int height, qsizetype bytes_per_line);
+}
+
+#endif
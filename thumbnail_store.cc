@@ -0,0 +1,587 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include "thumbnail_codec.h"
+#include "thumbnail_store.h"
+
+namespace
+{
+constexpr quint32 kRecordMagic = 0x31425454;
+constexpr quint32 kIndexMagic = 0x31495454;
+constexpr quint32 kIndexVersion = 3;
+constexpr qint64 kRecordHeaderBytes = 64;
+constexpr qint64 kRecordAlignment = 64;
+constexpr qint64 kMinCompactBytes = 32LL * 1024 * 1024;
+constexpr qint64 kAccessTimeGranularityMs = 60LL * 1000;
+constexpr quint32 kMaxDimension = 1U << 15;
+constexpr qint64 kBytesPerPixel = 4;
+
+struct record_header
+{
+    quint32 magic;
+    quint32 format;
+    quint64 key;
+    quint32 width;
+    quint32 height;
+    quint32 bytes_per_line;
+    quint32 codec;
+    qint64 payload_bytes;
+};
+
+static_assert(sizeof(record_header) <= kRecordHeaderBytes, "record header must fit in its reserved block");
+
+qint64 aligned_record_bytes(qint64 payload_bytes)
+{
+    const qint64 total = kRecordHeaderBytes + payload_bytes;
+    return (total + kRecordAlignment - 1) / kRecordAlignment * kRecordAlignment;
+}
+
+bool is_stored_format(quint32 format)
+{
+    switch (static_cast<QImage::Format>(format))
+    {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+        case QImage::Format_RGBX8888:
+        case QImage::Format_RGBA8888:
+        case QImage::Format_RGBA8888_Premultiplied:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_valid_layout(quint32 width, quint32 height, quint32 bytes_per_line, quint32 format, quint32 record_codec, qint64 payload_bytes)
+{
+    if (width == 0 || height == 0 || width > kMaxDimension || height > kMaxDimension || !is_stored_format(format) || payload_bytes <= 0)
+    {
+        return false;
+    }
+    if (bytes_per_line < static_cast<qint64>(width) * kBytesPerPixel || bytes_per_line % kBytesPerPixel != 0)
+    {
+        return false;
+    }
+    switch (static_cast<thumbnail_store::codec>(record_codec))
+    {
+        case thumbnail_store::codec::raw:
+            return static_cast<qint64>(bytes_per_line) * height <= payload_bytes;
+        case thumbnail_store::codec::qoi:
+            return true;
+    }
+    return false;
+}
+}
+
+thumbnail_store::mapped_region::~mapped_region()
+{
+    if (data != nullptr)
+    {
+        file.unmap(data);
+    }
+}
+
+thumbnail_store::thumbnail_store(const QString& dir, qint64 max_bytes, codec preferred_codec)
+    : dir_(dir), max_bytes_(max_bytes), preferred_codec_(preferred_codec)
+{
+    QDir().mkpath(dir_);
+    open_data_file();
+
+    if (!load_index())
+    {
+        index_.clear();
+        key_by_offset_.clear();
+        lru_.clear();
+        live_bytes_ = 0;
+        scan_records(0);
+    }
+
+    evict();
+}
+
+thumbnail_store::~thumbnail_store() { flush(); }
+
+QString thumbnail_store::data_path() const { return dir_ + "/thumbnails.pack"; }
+
+QString thumbnail_store::index_path() const { return dir_ + "/thumbnails.idx"; }
+
+void thumbnail_store::open_data_file()
+{
+    data_file_.setFileName(data_path());
+    if (!data_file_.open(QIODevice::ReadWrite))
+    {
+        data_size_ = 0;
+        return;
+    }
+    data_size_ = data_file_.size();
+}
+
+bool thumbnail_store::load_index()
+{
+    QFile file(index_path());
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint64 indexed_size = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> indexed_size >> count;
+    if (stream.status() != QDataStream::Ok || magic != kIndexMagic || version != kIndexVersion || indexed_size > data_size_)
+    {
+        return false;
+    }
+
+    std::vector<std::pair<quint64, entry>> entries;
+    entries.reserve(count);
+    for (quint32 i = 0; i < count; ++i)
+    {
+        quint64 key = 0;
+        entry e;
+        stream >> key >> e.offset >> e.record_bytes >> e.width >> e.height >> e.bytes_per_line >> e.format >> e.codec >> e.payload_bytes >>
+            e.last_access;
+        if (stream.status() != QDataStream::Ok || e.offset < 0 || e.offset % kRecordAlignment != 0 ||
+            e.record_bytes != aligned_record_bytes(e.payload_bytes) || e.offset + e.record_bytes > indexed_size ||
+            !is_valid_layout(e.width, e.height, e.bytes_per_line, e.format, e.codec, e.payload_bytes))
+        {
+            return false;
+        }
+        entries.emplace_back(key, e);
+    }
+
+    std::sort(entries.begin(),
+              entries.end(),
+              [](const auto& left, const auto& right) { return left.second.last_access < right.second.last_access; });
+
+    index_.reserve(static_cast<qsizetype>(entries.size()));
+    for (const auto& [key, e] : entries)
+    {
+        add_entry(key, e);
+    }
+
+    scan_records(indexed_size);
+    return true;
+}
+
+void thumbnail_store::scan_records(qint64 from_offset)
+{
+    if (!data_file_.isOpen())
+    {
+        return;
+    }
+
+    qint64 offset = from_offset;
+    while (offset + kRecordHeaderBytes <= data_size_)
+    {
+        record_header header{};
+        if (!data_file_.seek(offset) ||
+            data_file_.read(reinterpret_cast<char*>(&header), sizeof(header)) != static_cast<qint64>(sizeof(header)))
+        {
+            break;
+        }
+        if (header.magic != kRecordMagic ||
+            !is_valid_layout(header.width, header.height, header.bytes_per_line, header.format, header.codec, header.payload_bytes))
+        {
+            break;
+        }
+
+        const qint64 record_bytes = aligned_record_bytes(header.payload_bytes);
+        if (offset + record_bytes > data_size_)
+        {
+            break;
+        }
+
+        entry e;
+        e.offset = offset;
+        e.record_bytes = record_bytes;
+        e.width = header.width;
+        e.height = header.height;
+        e.bytes_per_line = header.bytes_per_line;
+        e.format = header.format;
+        e.codec = header.codec;
+        e.payload_bytes = header.payload_bytes;
+        e.last_access = QDateTime::currentMSecsSinceEpoch();
+        add_entry(header.key, e);
+        offset += record_bytes;
+    }
+
+    if (offset != data_size_)
+    {
+        data_file_.resize(offset);
+        data_size_ = offset;
+    }
+    if (offset != from_offset)
+    {
+        index_dirty_ = true;
+    }
+}
+
+bool thumbnail_store::ensure_mapped(qint64 end_offset)
+{
+    if (region_ != nullptr && end_offset <= region_->size)
+    {
+        return true;
+    }
+
+    auto region = std::make_shared<mapped_region>();
+    region->file.setFileName(data_path());
+    if (!region->file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    region->size = region->file.size();
+    if (region->size < end_offset)
+    {
+        return false;
+    }
+
+    region->data = region->file.map(0, region->size);
+    if (region->data == nullptr)
+    {
+        return false;
+    }
+
+    region_ = std::move(region);
+    return true;
+}
+
+QHash<quint64, thumbnail_store::entry>::iterator thumbnail_store::validated_entry(quint64 key)
+{
+    auto it = index_.find(key);
+    if (it == index_.end())
+    {
+        return it;
+    }
+
+    const entry& e = it.value();
+    if (!ensure_mapped(e.offset + e.record_bytes))
+    {
+        return index_.end();
+    }
+
+    record_header header{};
+    std::memcpy(&header, region_->data + e.offset, sizeof(header));
+    if (header.magic != kRecordMagic || header.key != key || header.payload_bytes != e.payload_bytes || header.width != e.width ||
+        header.height != e.height || header.bytes_per_line != e.bytes_per_line || header.format != e.format || header.codec != e.codec)
+    {
+        remove_entry(key);
+        return index_.end();
+    }
+    return it;
+}
+
+bool thumbnail_store::contains(quint64 key)
+{
+    QMutexLocker locker(&mutex_);
+    return validated_entry(key) != index_.end();
+}
+
+QImage thumbnail_store::find(quint64 key)
+{
+    QMutexLocker locker(&mutex_);
+    auto it = validated_entry(key);
+    if (it == index_.end())
+    {
+        return QImage();
+    }
+
+    // The in-memory order is exact; the persisted access time only moves in coarse steps so a hit does not force the
+    // index to be rewritten.
+    lru_.splice(lru_.begin(), lru_, it->lru_it);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - it->last_access >= kAccessTimeGranularityMs)
+    {
+        it->last_access = now;
+        index_dirty_ = true;
+    }
+
+    const entry e = it.value();
+    std::shared_ptr<mapped_region> region = region_;
+    const uchar* payload = region->data + e.offset + kRecordHeaderBytes;
+    if (e.codec == static_cast<quint32>(codec::qoi))
+    {
+        locker.unlock();
+        QImage image(static_cast<int>(e.width), static_cast<int>(e.height), static_cast<QImage::Format>(e.format));
+        if (image.isNull() ||
+            !thumbnail_codec::decode(payload, e.payload_bytes, image.bits(), image.width(), image.height(), image.bytesPerLine()))
+        {
+            return QImage();
+        }
+        return image;
+    }
+
+    auto* holder = new std::shared_ptr<mapped_region>(std::move(region));
+    return QImage(payload,
+                  static_cast<int>(e.width),
+                  static_cast<int>(e.height),
+                  static_cast<qsizetype>(e.bytes_per_line),
+                  static_cast<QImage::Format>(e.format),
+                  [](void* info) { delete static_cast<std::shared_ptr<mapped_region>*>(info); },
+                  holder);
+}
+
+void thumbnail_store::insert(quint64 key, const QImage& image)
+{
+    if (image.isNull() || !is_valid_layout(static_cast<quint32>(image.width()),
+                                           static_cast<quint32>(image.height()),
+                                           static_cast<quint32>(image.bytesPerLine()),
+                                           static_cast<quint32>(image.format()),
+                                           static_cast<quint32>(codec::raw),
+                                           image.sizeInBytes()))
+    {
+        return;
+    }
+
+    codec record_codec = codec::raw;
+    const uchar* payload = image.constBits();
+    qint64 payload_bytes = image.sizeInBytes();
+
+    QByteArray encoded;
+    if (preferred_codec_ == codec::qoi && image.depth() == 32)
+    {
+        encoded.resize(thumbnail_codec::max_encoded_size(image.width(), image.height()));
+        const qsizetype encoded_bytes = thumbnail_codec::encode(
+            image.constBits(), image.width(), image.height(), image.bytesPerLine(), reinterpret_cast<uchar*>(encoded.data()));
+        if (encoded_bytes < payload_bytes - (payload_bytes / 8))
+        {
+            record_codec = codec::qoi;
+            payload = reinterpret_cast<const uchar*>(encoded.constData());
+            payload_bytes = encoded_bytes;
+        }
+    }
+
+    QMutexLocker locker(&mutex_);
+    if (!data_file_.isOpen())
+    {
+        return;
+    }
+
+    const qint64 record_bytes = aligned_record_bytes(payload_bytes);
+    const qint64 offset = data_size_;
+
+    record_header header{kRecordMagic,
+                         static_cast<quint32>(image.format()),
+                         key,
+                         static_cast<quint32>(image.width()),
+                         static_cast<quint32>(image.height()),
+                         static_cast<quint32>(image.bytesPerLine()),
+                         static_cast<quint32>(record_codec),
+                         payload_bytes};
+    char header_block[kRecordHeaderBytes] = {};
+    std::memcpy(header_block, &header, sizeof(header));
+    const QByteArray padding(static_cast<qsizetype>(record_bytes - kRecordHeaderBytes - payload_bytes), '\0');
+
+    const bool written = data_file_.seek(offset) && data_file_.write(header_block, kRecordHeaderBytes) == kRecordHeaderBytes &&
+                         data_file_.write(reinterpret_cast<const char*>(payload), payload_bytes) == payload_bytes &&
+                         data_file_.write(padding) == padding.size() && data_file_.flush();
+    if (!written)
+    {
+        data_file_.resize(offset);
+        return;
+    }
+
+    entry e;
+    e.offset = offset;
+    e.record_bytes = record_bytes;
+    e.width = header.width;
+    e.height = header.height;
+    e.bytes_per_line = header.bytes_per_line;
+    e.format = header.format;
+    e.codec = header.codec;
+    e.payload_bytes = payload_bytes;
+    e.last_access = QDateTime::currentMSecsSinceEpoch();
+    add_entry(key, e);
+    data_size_ += record_bytes;
+
+    evict();
+}
+
+void thumbnail_store::add_entry(quint64 key, entry e)
+{
+    remove_entry(key);
+    lru_.push_front(key);
+    e.lru_it = lru_.begin();
+    key_by_offset_.emplace(e.offset, key);
+    live_bytes_ += e.record_bytes;
+    index_.insert(key, e);
+    index_dirty_ = true;
+}
+
+void thumbnail_store::remove_entry(quint64 key)
+{
+    auto it = index_.find(key);
+    if (it == index_.end())
+    {
+        return;
+    }
+
+    lru_.erase(it->lru_it);
+    key_by_offset_.erase(it->offset);
+    live_bytes_ -= it->record_bytes;
+    index_.erase(it);
+    index_dirty_ = true;
+}
+
+void thumbnail_store::evict()
+{
+    while (live_bytes_ > max_bytes_ && !lru_.empty())
+    {
+        remove_entry(lru_.back());
+    }
+}
+
+bool thumbnail_store::needs_compaction() const { return data_size_ - live_bytes_ > std::max(kMinCompactBytes, live_bytes_ / 2); }
+
+bool thumbnail_store::compaction_pending()
+{
+    QMutexLocker locker(&mutex_);
+    return !compacting_ && needs_compaction();
+}
+
+// Copies the live records into a fresh pack without holding the lock, so lookups and inserts keep running during the
+// whole-file copy. Records appended meanwhile are carried over as a tail; records dropped meanwhile stay behind as dead
+// bytes for the next pass.
+void thumbnail_store::compact()
+{
+    QMutexLocker locker(&mutex_);
+    if (compacting_ || !needs_compaction() || !ensure_mapped(data_size_))
+    {
+        return;
+    }
+
+    const std::shared_ptr<mapped_region> region = region_;
+    const qint64 snapshot_size = data_size_;
+    const quint64 snapshot_generation = generation_;
+    std::vector<std::pair<qint64, qint64>> records;
+    records.reserve(key_by_offset_.size());
+    for (const auto& [offset, key] : key_by_offset_)
+    {
+        records.emplace_back(offset, index_.value(key).record_bytes);
+    }
+    compacting_ = true;
+    locker.unlock();
+
+    const QString compact_path = data_path() + ".compact";
+    QFile out(compact_path);
+    bool copied = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    std::map<qint64, qint64> moved_offsets;
+    qint64 out_offset = 0;
+    for (auto it = records.cbegin(); copied && it != records.cend(); ++it)
+    {
+        const auto& [offset, record_bytes] = *it;
+        copied = out.write(reinterpret_cast<const char*>(region->data + offset), record_bytes) == record_bytes;
+        moved_offsets.emplace(offset, out_offset);
+        out_offset += record_bytes;
+    }
+
+    locker.relock();
+    compacting_ = false;
+    if (!copied || generation_ != snapshot_generation || !ensure_mapped(data_size_))
+    {
+        out.remove();
+        return;
+    }
+
+    const qint64 tail_offset = out_offset;
+    const qint64 tail_bytes = data_size_ - snapshot_size;
+    if (out.write(reinterpret_cast<const char*>(region_->data + snapshot_size), tail_bytes) != tail_bytes || !out.flush())
+    {
+        out.remove();
+        return;
+    }
+    out.close();
+
+    data_file_.close();
+    region_.reset();
+
+    if (QFile::exists(data_path()) && !QFile::remove(data_path()))
+    {
+        QFile::remove(compact_path);
+        open_data_file();
+        return;
+    }
+
+    if (QFile::rename(compact_path, data_path()))
+    {
+        std::map<qint64, quint64> compacted_offsets;
+        for (auto it = index_.begin(); it != index_.end(); ++it)
+        {
+            it->offset = it->offset >= snapshot_size ? tail_offset + (it->offset - snapshot_size) : moved_offsets.at(it->offset);
+            compacted_offsets.emplace(it->offset, it.key());
+        }
+        key_by_offset_ = std::move(compacted_offsets);
+    }
+    else
+    {
+        index_.clear();
+        key_by_offset_.clear();
+        lru_.clear();
+        live_bytes_ = 0;
+    }
+
+    open_data_file();
+    index_dirty_ = true;
+    write_index();
+}
+
+void thumbnail_store::write_index()
+{
+    QSaveFile file(index_path());
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << kIndexMagic << kIndexVersion << data_size_ << static_cast<quint32>(index_.size());
+    for (auto it = index_.constBegin(); it != index_.constEnd(); ++it)
+    {
+        const entry& e = it.value();
+        stream << it.key() << e.offset << e.record_bytes << e.width << e.height << e.bytes_per_line << e.format << e.codec << e.payload_bytes
+               << e.last_access;
+    }
+
+    if (stream.status() == QDataStream::Ok && file.commit())
+    {
+        index_dirty_ = false;
+    }
+}
+
+void thumbnail_store::flush()
+{
+    compact();
+
+    QMutexLocker locker(&mutex_);
+    if (index_dirty_)
+    {
+        write_index();
+    }
+}
+
+void thumbnail_store::clear()
+{
+    QMutexLocker locker(&mutex_);
+    data_file_.close();
+    region_.reset();
+    QFile::remove(data_path());
+    QFile::remove(index_path());
+
+    index_.clear();
+    key_by_offset_.clear();
+    lru_.clear();
+    live_bytes_ = 0;
+    index_dirty_ = false;
+    ++generation_;
+    open_data_file();
+}
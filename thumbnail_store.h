@@ -0,0 +1,93 @@
+#ifndef IMAGE_VIEWER_THUMBNAIL_STORE_H
+#define IMAGE_VIEWER_THUMBNAIL_STORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <list>
+#include <map>
+#include <memory>
+
+class thumbnail_store
+{
+   public:
+    enum class codec : quint32
+    {
+        raw = 0,
+        qoi = 1
+    };
+
+    thumbnail_store(const QString& dir, qint64 max_bytes, codec preferred_codec = codec::qoi);
+    ~thumbnail_store();
+
+    thumbnail_store(const thumbnail_store&) = delete;
+    thumbnail_store& operator=(const thumbnail_store&) = delete;
+
+    [[nodiscard]] QImage find(quint64 key);
+    [[nodiscard]] bool contains(quint64 key);
+    void insert(quint64 key, const QImage& image);
+    void clear();
+    void flush();
+
+    // True when dead records make up enough of the pack that compact() would reclaim space; eviction only drops index
+    // entries, so whoever inserts should check this and compact on a thread that can afford the copy.
+    [[nodiscard]] bool compaction_pending();
+    void compact();
+
+   private:
+    struct entry
+    {
+        qint64 offset = 0;
+        qint64 record_bytes = 0;
+        quint32 width = 0;
+        quint32 height = 0;
+        quint32 bytes_per_line = 0;
+        quint32 format = 0;
+        quint32 codec = 0;
+        qint64 payload_bytes = 0;
+        qint64 last_access = 0;
+        std::list<quint64>::iterator lru_it;
+    };
+
+    struct mapped_region
+    {
+        QFile file;
+        uchar* data = nullptr;
+        qint64 size = 0;
+
+        ~mapped_region();
+    };
+
+    [[nodiscard]] QString data_path() const;
+    [[nodiscard]] QString index_path() const;
+    void open_data_file();
+    bool load_index();
+    void scan_records(qint64 from_offset);
+    bool ensure_mapped(qint64 end_offset);
+    [[nodiscard]] QHash<quint64, entry>::iterator validated_entry(quint64 key);
+    void add_entry(quint64 key, entry e);
+    void remove_entry(quint64 key);
+    void evict();
+    [[nodiscard]] bool needs_compaction() const;
+    void write_index();
+
+   private:
+    QString dir_;
+    qint64 max_bytes_ = 0;
+    codec preferred_codec_ = codec::qoi;
+    QFile data_file_;
+    qint64 data_size_ = 0;
+    qint64 live_bytes_ = 0;
+    bool index_dirty_ = false;
+    bool compacting_ = false;
+    quint64 generation_ = 0;
+    QHash<quint64, entry> index_;
+    std::map<qint64, quint64> key_by_offset_;
+    std::list<quint64> lru_;
+    std::shared_ptr<mapped_region> region_;
+    QMutex mutex_;
+};
+
+#endif
@@ -14,6 +14,25 @@ static QPixmap& get_placeholder()
     return p;
 }
 
+static QPixmap& get_broken_placeholder()
+{
+    static QPixmap p;
+    if (p.isNull())
+    {
+        p = QPixmap(200, 200);
+        p.fill(QColor(64, 64, 64));
+
+        QPainter painter(&p);
+        painter.setRenderHint(QPainter::Antialiasing);
+        QPen pen(QColor(200, 80, 80), 8);
+        pen.setCapStyle(Qt::RoundCap);
+        painter.setPen(pen);
+        painter.drawLine(QPointF(70, 70), QPointF(130, 130));
+        painter.drawLine(QPointF(130, 70), QPointF(70, 130));
+    }
+    return p;
+}
+
 waterfall_item::waterfall_item(QGraphicsItem* parent) : QGraphicsPixmapItem(parent)
 {
     setFlag(QGraphicsItem::ItemIsSelectable);
@@ -32,11 +51,12 @@ void waterfall_item::bind_model(const layout_model& model, int display_width, qu
     current_request_id_ = request_id;
 
     is_hovered_ = false;
+    is_preview_ = false;
     setZValue(0);
     setGraphicsEffect(nullptr);
 
     setPos(model.layout_rect.topLeft());
-    setPixmap(get_placeholder());
+    setPixmap(model.signature.valid ? QPixmap::fromImage(model.signature.render(model.original_size)) : get_placeholder());
     update_scale();
     setVisible(true);
 }
@@ -48,6 +68,7 @@ void waterfall_item::reset()
     original_size_ = QSize();
     current_request_id_ = 0;
     is_hovered_ = false;
+    is_preview_ = false;
 
     setPixmap(get_placeholder());
     setGraphicsEffect(nullptr);
@@ -65,16 +86,25 @@ void waterfall_item::set_pixmap_safe(const QPixmap& pixmap)
     update_scale();
 }
 
+void waterfall_item::set_broken()
+{
+    is_preview_ = false;
+    set_pixmap_safe(get_broken_placeholder());
+}
+
 void waterfall_item::update_scale()
 {
-    if (pixmap().isNull() || pixmap().width() == 0 || target_width_ <= 0)
+    const QSizeF pixmap_size = pixmap().deviceIndependentSize();
+    if (pixmap().isNull() || pixmap_size.width() <= 0 || target_width_ <= 0)
     {
         return;
     }
 
-    base_scale_ = static_cast<qreal>(target_width_) / pixmap().width();
+    // Thumbnails arrive at device resolution with a ratio of 1; scaling by the target width instead of tagging the ratio
+    // keeps the pixmap shared with the loader's cache.
+    base_scale_ = static_cast<qreal>(target_width_) / pixmap_size.width();
 
-    setTransformOriginPoint(pixmap().rect().center());
+    setTransformOriginPoint(QRectF(QPointF(0, 0), pixmap_size).center());
 
     if (is_hovered_)
     {
@@ -123,6 +153,6 @@ void waterfall_item::paint(QPainter* painter, const QStyleOptionGraphicsItem* op
     QPen pen(QColor(255, 255, 255, 200), 6);
     pen.setJoinStyle(Qt::MiterJoin);
     painter->setPen(pen);
-    painter->drawRect(pixmap().rect());
+    painter->drawRect(QRectF(QPointF(0, 0), pixmap().deviceIndependentSize()));
     painter->restore();
 }
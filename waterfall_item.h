@@ -18,7 +18,11 @@ class waterfall_item : public QGraphicsPixmapItem
     [[nodiscard]] QString get_path() const { return path_; }
     [[nodiscard]] QSize get_original_size() const { return original_size_; }
     [[nodiscard]] quint64 get_request_id() const { return current_request_id_; }
+    void set_request_id(quint64 request_id) { current_request_id_ = request_id; }
+    [[nodiscard]] bool is_preview() const { return is_preview_; }
+    void set_preview(bool preview) { is_preview_ = preview; }
     void set_pixmap_safe(const QPixmap& pixmap);
+    void set_broken();
 
    protected:
     void hoverEnterEvent(QGraphicsSceneHoverEvent* event) override;
@@ -36,6 +40,7 @@ class waterfall_item : public QGraphicsPixmapItem
     quint64 current_request_id_ = 0;
     qreal base_scale_ = 1.0;
     bool is_hovered_ = false;
+    bool is_preview_ = false;
 };
 
 #endif
@@ -8,12 +8,22 @@
 #include <QFontMetrics>
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsView>
+#include <QCursor>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QDebug>
 #include <QtConcurrent>
 #include "common_types.h"
 #include "waterfall_scene.h"
 #include "waterfall_item.h"
 
+namespace
+{
+constexpr int kRefineDelayMs = 400;
+constexpr int kRefinePriorityOffset = 1 << 20;
+constexpr int kMaxOutstandingTasks = 48;
+}
+
 static layout_result calculate_layout_job(const std::vector<QSize>& sizes, int view_width, int generation, int kItemMargin, int kColumnMargin, int kMinColWidth)
 {
     layout_result result;
@@ -64,6 +74,11 @@ waterfall_scene::waterfall_scene(QObject* parent) : QGraphicsScene(parent)
 {
     connect(&layout_watcher_, &QFutureWatcher<layout_result>::finished, this, &waterfall_scene::on_layout_finished);
 
+    refine_timer_ = new QTimer(this);
+    refine_timer_->setSingleShot(true);
+    refine_timer_->setInterval(kRefineDelayMs);
+    connect(refine_timer_, &QTimer::timeout, this, &waterfall_scene::refine_previews);
+
     for (int i = 0; i < 20; ++i)
     {
         auto* item = new waterfall_item();
@@ -100,6 +115,11 @@ void waterfall_scene::clear_items()
     last_layout_index_ = 0;
     request_counter_ = 0;
     pending_view_width_ = 0;
+    pending_refines_.clear();
+    queued_tasks_.clear();
+    outstanding_ids_.clear();
+    background_requested_ = false;
+    background_width_ = 0;
 
     setSceneRect(0, 0, 0, 0);
 }
@@ -115,7 +135,9 @@ void waterfall_scene::add_images(const QList<image_meta>& batch)
         layout_model model;
         model.index = start_index + i;
         model.path = batch[i].path;
+        model.path_id = batch[i].path_id;
         model.original_size = batch[i].original_size;
+        model.signature = batch[i].signature;
 
         all_models_.push_back(model);
         item_y_index_.push_back(0);
@@ -214,6 +236,7 @@ void waterfall_scene::layout_models(int view_width)
             {
                 update_viewport(views().first()->mapToScene(views().first()->viewport()->rect()).boundingRect());
             }
+            submit_background_pass();
         }
         return;
     }
@@ -300,6 +323,7 @@ void waterfall_scene::on_layout_finished()
 
             update_viewport(visible_rect);
         }
+        submit_background_pass();
     }
 }
 
@@ -333,13 +357,21 @@ void waterfall_scene::update_viewport(const QRectF& visible_rect)
     }
 
     QSet<int> needed_indices;
-    QList<load_task> tasks_to_load;
-    QList<QString> paths_to_cancel;
+    QList<task_priority> priorities;
+    QList<quint64> ids_to_cancel;
 
     qreal dpr = 1.0;
+    focus_point_ = visible_rect.center();
     if (!views().isEmpty())
     {
-        dpr = views().first()->devicePixelRatio();
+        QGraphicsView* view = views().first();
+        dpr = view->devicePixelRatio();
+
+        const QPoint cursor_pos = view->viewport()->mapFromGlobal(QCursor::pos());
+        if (view->viewport()->rect().contains(cursor_pos))
+        {
+            focus_point_ = view->mapToScene(cursor_pos);
+        }
     }
 
     for (int i = start_idx; i <= end_idx; ++i)
@@ -351,9 +383,22 @@ void waterfall_scene::update_viewport(const QRectF& visible_rect)
         }
 
         needed_indices.insert(i);
+        const int priority = task_priority_for(model.layout_rect);
 
-        if (active_items_.contains(i))
+        auto active_it = active_items_.constFind(i);
+        if (active_it != active_items_.constEnd())
         {
+            const quint64 active_id = active_it.value()->get_request_id();
+            const int refine_offset = active_it.value()->is_preview() ? kRefinePriorityOffset : 0;
+            auto queued_it = queued_tasks_.find(active_id);
+            if (queued_it != queued_tasks_.end())
+            {
+                queued_it->priority = priority + refine_offset;
+            }
+            else if (outstanding_ids_.contains(active_id))
+            {
+                priorities.append({active_id, priority + refine_offset});
+            }
             continue;
         }
 
@@ -365,7 +410,7 @@ void waterfall_scene::update_viewport(const QRectF& visible_rect)
 
         int req_w = static_cast<int>(model.layout_rect.width() * dpr);
         int req_h = static_cast<int>(model.layout_rect.height() * dpr);
-        tasks_to_load.append({req_id, model.path, QSize(req_w, req_h), current_session_id_});
+        queued_tasks_.insert(req_id, {req_id, model.path, model.path_id, QSize(req_w, req_h), current_session_id_, priority, dpr, two_pass_});
     }
 
     auto current_keys = active_items_.keys();
@@ -374,19 +419,130 @@ void waterfall_scene::update_viewport(const QRectF& visible_rect)
         if (!needed_indices.contains(idx))
         {
             waterfall_item* item = active_items_.take(idx);
-            paths_to_cancel.append(item->get_path());
+            const quint64 id = item->get_request_id();
+            if (queued_tasks_.remove(id) == 0 && outstanding_ids_.remove(id))
+            {
+                ids_to_cancel.append(id);
+            }
+            pending_refines_.remove(id);
             recycle_item(item);
         }
     }
 
-    if (!tasks_to_load.isEmpty())
+    if (!ids_to_cancel.isEmpty())
+    {
+        emit request_cancel_batch(ids_to_cancel);
+    }
+    if (!priorities.isEmpty())
+    {
+        emit request_update_priorities(priorities);
+    }
+    submit_queued_tasks();
+
+    if (two_pass_)
+    {
+        refine_timer_->start();
+    }
+}
+
+void waterfall_scene::refine_previews()
+{
+    const qreal dpr = view_dpr();
+    for (auto it = active_items_.begin(); it != active_items_.end(); ++it)
+    {
+        waterfall_item* item = it.value();
+        if (!item->is_preview() || pending_refines_.contains(item->get_request_id()))
+        {
+            continue;
+        }
+
+        const layout_model& model = all_models_[it.key()];
+        const quint64 req_id = ++request_counter_;
+        item->set_request_id(req_id);
+        pending_refines_.insert(req_id);
+        queued_tasks_.insert(req_id,
+                             {req_id,
+                              model.path,
+                              model.path_id,
+                              QSize(static_cast<int>(model.layout_rect.width() * dpr), static_cast<int>(model.layout_rect.height() * dpr)),
+                              current_session_id_,
+                              kRefinePriorityOffset + task_priority_for(model.layout_rect),
+                              dpr,
+                              false});
+    }
+    submit_queued_tasks();
+}
+
+void waterfall_scene::submit_queued_tasks()
+{
+    const qsizetype credits = kMaxOutstandingTasks - outstanding_ids_.size();
+    if (credits <= 0 || queued_tasks_.isEmpty())
+    {
+        return;
+    }
+
+    QList<load_task> tasks(queued_tasks_.cbegin(), queued_tasks_.cend());
+    const auto batch_end = tasks.begin() + std::min(credits, tasks.size());
+    std::partial_sort(tasks.begin(),
+                      batch_end,
+                      tasks.end(),
+                      [](const load_task& left, const load_task& right)
+                      { return left.priority != right.priority ? left.priority < right.priority : left.id < right.id; });
+    tasks.erase(batch_end, tasks.end());
+
+    for (const auto& task : tasks)
+    {
+        queued_tasks_.remove(task.id);
+        outstanding_ids_.insert(task.id);
+    }
+    emit request_load_batch(tasks);
+}
+
+void waterfall_scene::start_background_pass()
+{
+    background_requested_ = true;
+    background_width_ = 0;
+    submit_background_pass();
+}
+
+void waterfall_scene::submit_background_pass()
+{
+    if (!background_requested_ || layout_watcher_.isRunning() || last_layout_index_ < all_models_.size())
+    {
+        return;
+    }
+
+    const qreal dpr = view_dpr();
+    const int width = static_cast<int>(current_col_width_ * dpr);
+    if (width == background_width_)
+    {
+        return;
+    }
+    background_width_ = width;
+
+    QList<load_task> tasks;
+    tasks.reserve(static_cast<qsizetype>(all_models_.size()));
+    for (const auto& model : all_models_)
     {
-        emit request_load_batch(tasks_to_load);
+        tasks.append({static_cast<quint64>(model.index),
+                      model.path,
+                      model.path_id,
+                      QSize(static_cast<int>(model.layout_rect.width() * dpr), static_cast<int>(model.layout_rect.height() * dpr)),
+                      current_session_id_});
     }
-    if (!paths_to_cancel.isEmpty())
+    emit request_background_batch(tasks);
+}
+
+qreal waterfall_scene::view_dpr() const { return views().isEmpty() ? 1.0 : views().first()->devicePixelRatio(); }
+
+int waterfall_scene::task_priority_for(const QRectF& rect) const
+{
+    const QPointF delta = rect.center() - focus_point_;
+    if (rect.contains(focus_point_))
     {
-        emit request_cancel_batch(paths_to_cancel);
+        return 0;
     }
+    return 1 + static_cast<int>(std::hypot(delta.x(), delta.y()));
 }
 
 waterfall_item* waterfall_scene::obtain_item()
@@ -412,53 +568,50 @@ void waterfall_scene::recycle_item(waterfall_item* item)
     pool_.push(item);
 }
 
-void waterfall_scene::on_image_loaded(quint64 id, const QString& /*path*/, const QImage& image, int session_id)
+qint64 waterfall_scene::on_images_loaded(std::vector<thumbnail_result> results)
 {
-    if (session_id != current_session_id_)
-    {
-        return;
-    }
+    qint64 conversion_ns = 0;
+    QElapsedTimer timer;
 
+    QHash<quint64, waterfall_item*> items_by_request;
+    items_by_request.reserve(active_items_.size());
     for (auto it = active_items_.begin(); it != active_items_.end(); ++it)
     {
-        waterfall_item* item = it.value();
-        if (item->get_request_id() == id)
-        {
-            item->set_pixmap_safe(QPixmap::fromImage(image));
-            return;
-        }
-    }
-}
-
-void waterfall_scene::on_tasks_dropped(const QList<QString>& paths)
-{
-    if (paths.isEmpty() || views().isEmpty())
-    {
-        return;
+        items_by_request.insert(it.value()->get_request_id(), it.value());
     }
 
-    QSet<QString> dropped_set(paths.begin(), paths.end());
-    QList<load_task> retry_tasks;
-    qreal dpr = views().first()->devicePixelRatio();
-
-    for (auto it = active_items_.begin(); it != active_items_.end(); ++it)
+    for (auto& result : results)
     {
-        waterfall_item* item = it.value();
-        if (item == nullptr || !dropped_set.contains(item->get_path()))
+        if (result.session_id != current_session_id_)
         {
             continue;
         }
+        outstanding_ids_.remove(result.id);
+        if (!result.preview)
+        {
+            pending_refines_.remove(result.id);
+        }
 
-        const layout_model& model = all_models_[it.key()];
-        int req_w = static_cast<int>(model.layout_rect.width() * dpr);
-        int req_h = static_cast<int>(model.layout_rect.height() * dpr);
-        retry_tasks.append({item->get_request_id(), model.path, QSize(req_w, req_h), current_session_id_});
-    }
-
-    if (!retry_tasks.isEmpty())
-    {
-        emit request_load_batch(retry_tasks);
+        waterfall_item* item = items_by_request.value(result.id, nullptr);
+        if (item != nullptr && result.broken)
+        {
+            item->set_broken();
+        }
+        else if (item != nullptr && !result.image.isNull())
+        {
+            timer.start();
+            QPixmap pixmap = QPixmap::fromImage(std::move(result.image), Qt::NoFormatConversion);
+            conversion_ns += timer.nsecsElapsed();
+            item->set_pixmap_safe(pixmap);
+            item->set_preview(result.preview);
+            if (result.preview && !refine_timer_->isActive())
+            {
+                refine_timer_->start();
+            }
+        }
     }
+    submit_queued_tasks();
+    return conversion_ns;
 }
 
 std::vector<QString> waterfall_scene::get_all_paths() const
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <QHash>
+#include <QSet>
 #include <QStack>
 #include <QObject>
 #include <QStringList>
@@ -14,6 +15,7 @@
 #include "common_types.h"
 
 class waterfall_item;
+class QTimer;
 
 class waterfall_scene : public QGraphicsScene
 {
@@ -30,11 +32,16 @@ class waterfall_scene : public QGraphicsScene
     bool focus_path(const QString& path);
     void set_recent_paths(const QStringList& recent_folder_paths, const QStringList& recent_image_paths);
     [[nodiscard]] std::vector<QString> get_all_paths() const;
+    void set_two_pass(bool enabled) { two_pass_ = enabled; }
+    void start_background_pass();
+    qint64 on_images_loaded(std::vector<thumbnail_result> results);
 
    signals:
     void request_cancel_all();
     void request_load_batch(const QList<load_task>& tasks);
-    void request_cancel_batch(const QList<QString>& paths);
+    void request_background_batch(const QList<load_task>& tasks);
+    void request_update_priorities(const QList<task_priority>& priorities);
+    void request_cancel_batch(const QList<quint64>& ids);
     void image_double_clicked(QString path);
     void request_open_folder();
     void request_open_recent(QString path);
@@ -42,18 +49,19 @@ class waterfall_scene : public QGraphicsScene
     void request_move_to_trash(QString path);
     void request_clear_thumbnail_cache();
 
-   public slots:
-    void on_image_loaded(quint64 id, const QString& path, const QImage& image, int session_id);
-    void on_tasks_dropped(const QList<QString>& paths);
-
    private slots:
     void on_layout_finished();
+    void refine_previews();
 
    protected:
     void mouseDoubleClickEvent(QGraphicsSceneMouseEvent* event) override;
     void contextMenuEvent(QGraphicsSceneContextMenuEvent* event) override;
 
    private:
+    [[nodiscard]] int task_priority_for(const QRectF& rect) const;
+    [[nodiscard]] qreal view_dpr() const;
+    void submit_queued_tasks();
+    void submit_background_pass();
     waterfall_item* obtain_item();
     void recycle_item(waterfall_item* item);
 
@@ -69,6 +77,14 @@ class waterfall_scene : public QGraphicsScene
     int current_session_id_ = 0;
     int layout_generation_ = 0;
     quint64 request_counter_ = 0;
+    QPointF focus_point_;
+    QTimer* refine_timer_ = nullptr;
+    QSet<quint64> pending_refines_;
+    QHash<quint64, load_task> queued_tasks_;
+    QSet<quint64> outstanding_ids_;
+    bool two_pass_ = true;
+    bool background_requested_ = false;
+    int background_width_ = 0;
 
     QFutureWatcher<layout_result> layout_watcher_;
     bool is_laying_out_ = false;